@@ -0,0 +1,202 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vk_utilities.hpp"
+#include "mapped_file.hpp"
+#include "cephalopod_engine.hpp"
+#include "worksheet.hpp"
+
+struct BenchOptions {
+    const char* input_path; // benchmarks this file instead of a generated worksheet
+    const char* write_path; // writes the generated worksheet here instead of benchmarking it
+    WorksheetShape shape{.problem_count = 1 << 20, .values_per_problem = 4};
+    size_t warmup_count = 3;
+    size_t repetition_count = 20;
+    EngineConfig engine_config;
+
+    static std::optional<BenchOptions> parse(int argc, char* argv[]);
+};
+
+// the median and 99th percentile (nearest rank) of one phase over every repetition
+struct PhaseStatistics {
+    double median;
+    double p99;
+
+    static PhaseStatistics of(std::vector<double> samples);
+};
+
+static void print_phase(const char* name, const std::vector<double>& samples) {
+    PhaseStatistics statistics = PhaseStatistics::of(samples);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(3)
+        << std::setw(12) << statistics.median << std::setw(12) << statistics.p99 << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::optional<BenchOptions> options = BenchOptions::parse(argc, argv);
+    if (!options.has_value()) {
+        std::cout << "usage: " << argv[0]
+            << " [--problems <count>] [--rows <count>] [--digits <min>-<max>] [--uniform-values] [--mul-fraction <0..1>] [--seed <seed>]"
+            << " [--write <path>|--input <path>] [--warmup <count>] [--repetitions <count>]"
+            << " [--native|--auto] [--gpu-parse [--gpu-partition]] [--layout aos|soa] [--fused] [--mixed] [--tree-reduction] [--chunk <problems>]" << std::endl;
+        return 0;
+    }
+
+    MappedFile input_file;
+    std::string generated_text;
+    std::string_view worksheet_text;
+    if (options->input_path != nullptr) {
+        if (!input_file.open(options->input_path)) {
+            std::cout << "failed to open input file " << options->input_path << std::endl;
+            return 0;
+        }
+        worksheet_text = std::string_view(input_file.data(), input_file.size());
+    } else {
+        generated_text = generate_worksheet(options->shape);
+        worksheet_text = generated_text;
+    }
+
+    if (options->write_path != nullptr) {
+        std::ofstream output(options->write_path, std::ios::binary);
+        output.write(worksheet_text.data(), static_cast<std::streamsize>(worksheet_text.size()));
+        if (!output) std::cout << "failed to write " << options->write_path << std::endl;
+        return 0;
+    }
+
+    Worksheet worksheet = Worksheet::scan(worksheet_text.data(), worksheet_text.size());
+    std::cout << "worksheet: " << worksheet.total_problem_count() << " problems (" << worksheet.mul_problem_count << " products) x "
+        << worksheet.values_per_problem() << " rows, " << worksheet_text.size() << " bytes" << std::endl;
+
+    CephalopodEngine engine;
+    VK_CHECK(engine.init(options->engine_config));
+
+    uint64_t expected_result = 0;
+    for (size_t warmup = 0; warmup < options->warmup_count; warmup++) { // pipeline creation, buffer growth and cold caches
+        VK_CHECK(engine.solve(worksheet_text, expected_result));
+    }
+
+    std::vector<double> parse, layout, fill, record, submit, readback, total;
+    for (size_t repetition = 0; repetition < options->repetition_count; repetition++) {
+        uint64_t result;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        VK_CHECK(engine.solve(worksheet_text, result));
+        std::chrono::duration<double, std::milli> solve_time = std::chrono::steady_clock::now() - begin;
+
+        if (repetition == 0 && options->warmup_count == 0) expected_result = result;
+        if (result != expected_result) std::cout << "warning: repetition " << repetition << " gave " << result << " instead of " << expected_result << std::endl;
+
+        const PhaseTimings& timings = engine.last_phase_timings();
+        parse.push_back(timings.parse);
+        layout.push_back(timings.layout);
+        fill.push_back(timings.fill);
+        record.push_back(timings.record);
+        submit.push_back(timings.submit);
+        readback.push_back(timings.readback);
+        total.push_back(solve_time.count());
+    }
+
+    if (total.empty()) return 0;
+    std::cout << "Result: " << expected_result << std::endl;
+    std::cout << std::left << std::setw(10) << "phase" << std::right << std::setw(12) << "median ms" << std::setw(12) << "p99 ms" << std::endl;
+    print_phase("parse", parse);
+    print_phase("layout", layout);
+    print_phase("fill", fill);
+    print_phase("record", record);
+    print_phase("submit", submit);
+    print_phase("readback", readback);
+    print_phase("total", total);
+
+    double median_seconds = PhaseStatistics::of(total).median / 1000.0;
+    std::cout << std::setprecision(3) << "throughput: " << worksheet_text.size() / median_seconds / 1e9 << " GB/s, "
+        << worksheet.total_problem_count() / median_seconds / 1e6 << " M problems/s" << std::endl;
+
+    return 0;
+}
+
+PhaseStatistics PhaseStatistics::of(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    size_t count = samples.size();
+    double median = count % 2 == 1 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2.0;
+    size_t p99_rank = static_cast<size_t>(std::ceil(0.99 * static_cast<double>(count)));
+    return {.median = median, .p99 = samples[std::max<size_t>(p99_rank, 1) - 1]};
+}
+
+static bool parse_count(const char* text, size_t& count) {
+    char* end;
+    count = std::strtoull(text, &end, 10);
+    return *end == '\0' && end != text;
+}
+
+std::optional<BenchOptions> BenchOptions::parse(int argc, char* argv[]) {
+    BenchOptions options{};
+    options.engine_config.crossover_path = ""; // a benchmark shouldn't leave files behind, --auto calibrates every run
+    for (int index = 1; index < argc; index++) { // first argument is implicit (the path of the executable)
+        std::string_view argument(argv[index]);
+        bool has_value = index + 1 < argc;
+        if (argument == "--problems" && has_value) {
+            if (!parse_count(argv[++index], options.shape.problem_count)) return std::nullopt;
+        } else if (argument == "--rows" && has_value) {
+            if (!parse_count(argv[++index], options.shape.values_per_problem)) return std::nullopt;
+        } else if (argument == "--digits" && has_value) {
+            char* end;
+            options.shape.min_digits = std::strtoull(argv[++index], &end, 10);
+            if (*end != '-') return std::nullopt;
+            options.shape.max_digits = std::strtoull(end + 1, &end, 10);
+            if (*end != '\0' || options.shape.min_digits < 1 || options.shape.min_digits > options.shape.max_digits || options.shape.max_digits > 9) return std::nullopt;
+        } else if (argument == "--uniform-values") {
+            options.shape.value_distribution = ValueDistribution::UNIFORM_VALUE;
+        } else if (argument == "--mul-fraction" && has_value) {
+            char* end;
+            options.shape.mul_fraction = std::strtod(argv[++index], &end);
+            if (*end != '\0' || !(options.shape.mul_fraction >= 0.0 && options.shape.mul_fraction <= 1.0)) return std::nullopt;
+        } else if (argument == "--seed" && has_value) {
+            size_t seed;
+            if (!parse_count(argv[++index], seed)) return std::nullopt;
+            options.shape.seed = seed;
+        } else if (argument == "--write" && has_value) {
+            options.write_path = argv[++index];
+        } else if (argument == "--input" && has_value) {
+            options.input_path = argv[++index];
+        } else if (argument == "--warmup" && has_value) {
+            if (!parse_count(argv[++index], options.warmup_count)) return std::nullopt;
+        } else if (argument == "--repetitions" && has_value) {
+            if (!parse_count(argv[++index], options.repetition_count)) return std::nullopt;
+        } else if (argument == "--native") {
+            options.engine_config.backend = Backend::NATIVE;
+        } else if (argument == "--auto") {
+            options.engine_config.backend = Backend::AUTO;
+        } else if (argument == "--gpu-parse") {
+            options.engine_config.gpu_parse = true;
+        } else if (argument == "--gpu-partition") {
+            options.engine_config.gpu_parse = true; // partitions what the gpu tokenizer parses
+            options.engine_config.gpu_partition = true;
+        } else if (argument == "--fused") {
+            options.engine_config.fused = true;
+        } else if (argument == "--mixed") {
+            options.engine_config.mixed = true;
+        } else if (argument == "--tree-reduction") {
+            options.engine_config.tree_reduction = true;
+        } else if (argument == "--chunk" && has_value) {
+            if (!parse_count(argv[++index], options.engine_config.chunk_problem_count) || options.engine_config.chunk_problem_count == 0) return std::nullopt;
+        } else if (argument == "--layout" && has_value) {
+            std::string_view layout(argv[++index]);
+            if (layout == "aos") options.engine_config.problem_layout = ProblemLayout::PROBLEM_MAJOR;
+            else if (layout == "soa") options.engine_config.problem_layout = ProblemLayout::VALUE_MAJOR;
+            else return std::nullopt;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    if (options.shape.values_per_problem == 0) return std::nullopt;
+    return options;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vk_mem_alloc.h"
+#include "worksheet.hpp"
+#include "wide_integer.hpp"
+#include "dispatch_profiler.hpp"
+#include "worker_pool.hpp"
+
+enum Backend : uint32_t {
+    VULKAN = 0,
+    NATIVE = 1, // threads and simd on the host, never touches vulkan, for machines without a usable gpu
+    AUTO = 2 // native below a calibrated crossover (in values), vulkan above it, see EngineConfig::crossover_path
+};
+
+struct EngineConfig {
+    Backend backend = Backend::VULKAN;
+    bool allow_cpu_device = false; // let the vulkan backend pick a cpu implementation (lavapipe, swiftshader) when there is no gpu
+    size_t thread_count = 0; // native and auto backends, threads of the worker pool init starts, 0 uses every core
+    bool profile_dispatches = false; // gpu timestamps around every dispatch, see CephalopodEngine::last_dispatch_timings
+    bool collect_metrics = false; // also counts shader invocations and vma's memory use, see CephalopodEngine::last_metrics, implies profile_dispatches
+    std::string crossover_path = "backend_crossover.txt"; // the auto backend's crossover, calibrated and saved here on first use, empty to calibrate every run
+    std::string shader_directory = "shaders"; // where the compiled .spv files live
+    std::string pipeline_cache_path = "pipeline_cache.bin"; // loaded on init and written back on destruction, empty to disable
+    bool gpu_parse = false; // upload the raw text and tokenize it on the gpu instead of parsing on the host
+    bool gpu_partition = false; // with gpu_parse, upload an op mask and let the gpu work out where each problem goes instead of the host, ignored when mixed
+    ProblemLayout problem_layout = ProblemLayout::PROBLEM_MAJOR;
+    bool fused = false; // reduce each workgroup's results as they are solved so only one partial per workgroup is written
+    bool tree_reduction = false; // keep the multi-dispatch shared memory reduction even where subgroup atomics are available
+    bool wide = false; // 128-bit products and sums with overflow counting, see CephalopodEngine::solve_wide
+    uint32_t modulus = 0; // non-zero solves everything modulo this (odd, below 2^31, usually a prime) with montgomery multiplication
+    bool exact = false; // solves modulo enough primes to rebuild the exact total with the crt, see CephalopodEngine::solve_exact
+    bool mixed = false; // problems stay in file order with an operator bit each and one dispatch solves both operators, results come out in file order
+    size_t chunk_problem_count = 1 << 16; // host parsing is pipelined with the gpu a chunk of this many problems at a time (or fewer when memory is tight)
+};
+
+struct Queues {
+    VkQueue compute;
+    VkQueue transfer; // the compute queue again when the device has no dedicated transfer family
+};
+
+struct QueueFamilyIndices {
+    inline static const float DEFAULT_QUEUE_PRIORITY = 1.0f;
+    std::optional<uint32_t> compute;
+    std::optional<uint32_t> transfer; // transfer only (dma engine), optional
+    uint32_t compute_timestamp_valid_bits = 0; // zero if the compute family can't write timestamps
+
+    static QueueFamilyIndices find(VkPhysicalDevice gpu);
+    bool is_complete() const;
+    uint32_t transfer_or_compute() const;
+    std::vector<VkDeviceQueueCreateInfo> make_queue_create_infos() const;
+    Queues get_queues(VkDevice device) const;
+};
+
+// the grand total of a solve, only wide solves use the high limb and count overflows
+struct SolveTotal {
+    UInt128 value;
+    uint64_t overflow_count; // products and sums that didn't fit in 128 bits, zero means the value is exact
+    std::vector<uint64_t> residues; // the narrow total for every modulus it was solved with, several only for exact solves
+};
+
+// host time the phases of the last solve took in milliseconds, summed over every chunk,
+// a chunk's fill and record overlap the gpu solving the chunks before it
+struct PhaseTimings {
+    double parse; // splitting the text into rows
+    double layout; // chunking, buffer layout and growth, pipeline lookup
+    double fill; // mapping and writing the problems (tokenizing included) or the raw text for the gpu parser
+    double record; // command buffer recording
+    double submit; // uploads, submits and every wait for the gpu until the last chunk is solved (the whole solve when native)
+    double readback; // copying the partial sums back and adding them up
+};
+
+// what the dispatches of one kind (see DispatchKind) added up to over a solve
+struct KernelMetrics {
+    size_t dispatch_count; // profiled spans, a span may hold several dispatches of one kernel
+    double ms;
+    uint64_t byte_count;
+};
+
+// counters of the last solve for dashboards, the gpu ones are only filled when it ran on vulkan with EngineConfig::collect_metrics
+struct SolveMetrics {
+    Backend backend; // what the solve ran on, never AUTO
+    size_t problem_count;
+    size_t value_count;
+    size_t text_bytes; // parsed, by the host or the gpu tokenizer
+    size_t uploaded_bytes; // written for the gpu to read, into the mapped working buffer or the staging buffer
+    double solve_ms; // host wall time, parsing included
+    PhaseTimings phases;
+    std::optional<KernelMetrics> kernels[3]; // indexed by DispatchKind
+    std::optional<uint64_t> compute_invocation_count; // needs the pipelineStatisticsQuery feature
+    std::optional<VmaStatistics> memory; // every block vma holds and the allocations in them
+};
+
+// one json object, gpu counters that weren't collected are null
+void write_metrics_json(const SolveMetrics& metrics, std::ostream& output);
+
+// owns the whole vulkan context (none at all for the native backend), initialize once and then solve as many worksheets as needed,
+// the device, pipelines, command buffer and working buffer are all reused between calls
+class CephalopodEngine {
+private:
+    EngineConfig config;
+    bool vulkan_ready = false; // init_vulkan finished, only ever set once
+    std::optional<size_t> crossover; // the auto backend solves worksheets with fewer values than this on the host
+    std::optional<double> startup_ms; // how long init_vulkan took, empty until vulkan is up
+    PhaseTimings phase_timings{};
+    SolveMetrics metrics{};
+    DispatchProfiler profiler; // does nothing unless EngineConfig::profile_dispatches
+    WorkerPool worker_pool; // the native backend's threads, started once by init and reused by every solve
+    std::vector<DispatchTiming> dispatch_timings;
+
+    // timestamp pairs per solve, a few per chunk and modulus, later spans are dropped with a warning
+    inline static const uint32_t DISPATCH_SPAN_CAPACITY = 4096;
+
+    // the generated worksheet the auto backend calibrates with, large enough that fixed costs stop mattering
+    inline static const size_t CALIBRATION_PROBLEM_COUNT = 1 << 18;
+    inline static const size_t CALIBRATION_VALUES_PER_PROBLEM = 4;
+
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice gpu = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties gpu_properties{};
+    uint32_t max_workgroup_count = 0; // along x in one dispatch, also small enough that the dispatch's problem count fits in 32 bits
+    QueueFamilyIndices queue_family_indices;
+    Queues queues{};
+    VkDevice device = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    bool atomic_reduction = false;
+
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    VkShaderModule math_shader = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    std::map<std::pair<uint32_t, uint32_t>, VkPipeline> math_pipelines; // keyed by opcode and unrolled value count (0 for any count)
+    VkShaderModule parse_shader = VK_NULL_HANDLE;
+    VkPipelineLayout parse_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline parse_pipeline = VK_NULL_HANDLE;
+    VkShaderModule sum_shader = VK_NULL_HANDLE;
+    VkPipeline sum_pipeline = VK_NULL_HANDLE;
+
+    // chunks in flight at once, each owns a slot of the working and staging buffers and its own command buffers
+    inline static const size_t PIPELINE_DEPTH = 3;
+
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer compute_command_buffers[PIPELINE_DEPTH]{};
+    VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
+    VkCommandBuffer upload_command_buffers[PIPELINE_DEPTH]{};
+    VkCommandBuffer readback_command_buffer = VK_NULL_HANDLE;
+
+    // every compute submit signals the next value of compute_timeline and every transfer submit the next value of transfer_timeline
+    VkSemaphore compute_timeline = VK_NULL_HANDLE;
+    VkSemaphore transfer_timeline = VK_NULL_HANDLE;
+    uint64_t compute_timeline_value = 0;
+    uint64_t transfer_timeline_value = 0;
+
+    // the working buffer prefers device local memory, when that memory can't be mapped (no rebar/uma)
+    // the host fills the staging buffer instead and the partial sums come back through the readback buffer
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation buffer_allocation = VK_NULL_HANDLE;
+    VkDeviceAddress buffer_address = 0;
+    size_t buffer_capacity = 0;
+    bool buffer_host_visible = false;
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    VmaAllocation staging_allocation = VK_NULL_HANDLE;
+    VkBuffer readback_buffer = VK_NULL_HANDLE;
+    VmaAllocation readback_allocation = VK_NULL_HANDLE;
+    size_t readback_capacity = 0;
+
+    VkResult reserve_buffer(size_t size); // grows the working buffer, never shrinks it
+    size_t buffer_memory_budget() const; // how large reserve_buffer can safely go given what the heaps have left
+    VkResult reserve_readback_buffer(size_t size);
+    VkResult get_math_pipeline(uint32_t opcode, uint32_t values_per_problem, VkPipeline& pipeline); // created on first use
+    VkResult get_solve_pipelines(size_t values_per_problem, VkPipeline& add_pipeline, VkPipeline& mul_pipeline); // the mixed pipeline and null when mixed
+    VkResult upload(size_t slot, size_t offset, size_t size, uint64_t& upload_value); // staging to working buffer, on the transfer queue
+    void record_partial_sum(
+        VkCommandBuffer command_buffer,
+        VkPipeline combine_pipeline,
+        size_t result_count,
+        size_t results_offset,
+        size_t scratch_offset,
+        size_t partial_offset,
+        size_t overflow_offset,
+        uint32_t modulus
+    );
+    // solves a chunk whose problems are already in the working buffer once per modulus,
+    // each modulus' partial sum lands partials_stride bytes after the previous one's, a mixed solve passes its pipeline as add_pipeline
+    void record_solve_chunk(
+        VkCommandBuffer command_buffer,
+        VkPipeline add_pipeline,
+        VkPipeline mul_pipeline,
+        VkPipeline combine_pipeline,
+        const WorksheetChunk& chunk,
+        size_t values_per_problem,
+        size_t chunk_offset,
+        const std::vector<uint32_t>& moduli,
+        size_t partial_offset,
+        size_t partials_stride,
+        size_t overflow_offset
+    );
+    void record_overflow_reset(VkCommandBuffer command_buffer, size_t overflow_offset); // does nothing unless wide
+    size_t result_size() const; // of one result or partial sum
+    size_t partials_size(size_t partial_count) const; // partial sums followed by their overflow counts when wide
+    VkResult sum_partials(size_t partials_offset, size_t partial_count, const std::vector<uint32_t>& moduli, SolveTotal& total);
+    VkResult init_vulkan();
+    VkResult choose_backend(size_t value_count, Backend& backend); // loads or calibrates the crossover and brings vulkan up if needed
+    VkResult calibrate_crossover(size_t& crossover);
+    std::vector<uint32_t> moduli_for(const Worksheet& worksheet) const;
+    VkResult solve_total(std::string_view worksheet_text, SolveTotal& total);
+    VkResult solve_worksheet(const Worksheet& worksheet, Backend backend, const std::vector<uint32_t>& moduli, SolveTotal& total);
+    VkResult solve_chunked(const Worksheet& worksheet, const std::vector<uint32_t>& moduli, SolveTotal& total);
+    VkResult solve_gpu_parse(const Worksheet& worksheet, const std::vector<uint32_t>& moduli, SolveTotal& total);
+    std::string shader_path(const char* name) const;
+
+public:
+    CephalopodEngine() = default;
+    ~CephalopodEngine();
+    CephalopodEngine(const CephalopodEngine&) = delete;
+    CephalopodEngine& operator=(const CephalopodEngine&) = delete;
+
+    VkResult init(const EngineConfig& config);
+    VkResult solve(std::string_view worksheet_text, uint64_t& result); // wraps modulo 2^64, or modulo EngineConfig::modulus if set
+    VkResult solve_wide(std::string_view worksheet_text, UInt128& result, uint64_t& overflow_count); // needs EngineConfig::wide
+    VkResult solve_exact(std::string_view worksheet_text, BigUInt& result); // needs EngineConfig::exact
+    const PhaseTimings& last_phase_timings() const;
+    const std::vector<DispatchTiming>& last_dispatch_timings() const; // empty unless profiling and the last solve ran on vulkan
+    const SolveMetrics& last_metrics() const;
+    std::optional<double> vulkan_startup_ms() const; // empty while the native or auto backend hasn't needed vulkan
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "wide_integer.hpp"
+
+// the largest primes below 2^31 in descending order, the moduli of an exact solve
+std::vector<uint32_t> crt_moduli(size_t count);
+
+// the unique value below the product of the moduli (distinct primes) that has the given residue modulo each of them
+BigUInt crt_reconstruct(const std::vector<uint64_t>& residues, const std::vector<uint32_t>& moduli);
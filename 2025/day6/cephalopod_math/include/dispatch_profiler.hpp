@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum DispatchKind : uint32_t {
+    PARSE = 0, // the gpu tokenizer's passes
+    SOLVE = 1, // add and mul problems, fused ones include their workgroup reduction
+    REDUCE = 2 // the combine tree levels or the atomic sum, and the copy of the partial sum
+};
+
+// one span of a solve's command buffers, times are relative to the start of the solve's first span
+struct DispatchTiming {
+    std::string label;
+    DispatchKind kind;
+    double start_ms;
+    double duration_ms;
+    double gap_ms; // since the previous span ended, the barrier between them plus any idle time
+    uint64_t byte_count; // what the span's dispatches read
+
+    double gigabytes_per_second() const; // effective bandwidth, byte_count over the duration
+};
+
+// timestamps around labelled spans of the compute command buffers, every span of a solve shares one query pool,
+// both timestamps of a span wait for all previous commands so a span covers exactly its own dispatches
+class DispatchProfiler {
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool query_pool = VK_NULL_HANDLE; // null when profiling is off, every call then does nothing
+    uint32_t span_capacity = 0;
+    double nanoseconds_per_tick = 0.0;
+    uint64_t tick_mask = 0; // the compute queue only writes timestampValidBits bits
+    std::vector<std::string> labels; // span n is timed by queries 2n and 2n + 1
+    std::vector<DispatchKind> kinds;
+    std::vector<uint64_t> byte_counts;
+    size_t dropped_span_count = 0;
+    // compute shader invocations of every compute command buffer, null unless counting them (needs pipelineStatisticsQuery)
+    VkQueryPool statistics_query_pool = VK_NULL_HANDLE;
+    uint32_t statistics_query_count = 0;
+    // samples the device and host clocks together (VK_KHR/EXT_calibrated_timestamps), null when the device can't
+    PFN_vkGetCalibratedTimestampsKHR get_calibrated_timestamps = nullptr;
+    VkTimeDomainKHR host_time_domain{};
+
+    // when the first span began on the host clock, found from one calibrated sample of both clocks,
+    // or without calibration by assuming the last span ended just now
+    std::chrono::steady_clock::time_point host_origin(uint64_t origin_tick, uint64_t last_end_tick) const;
+
+public:
+    inline static const uint32_t NO_SPAN = UINT32_MAX;
+    std::string scope; // prefixed to every label, like the chunk being recorded
+
+    DispatchProfiler() = default;
+    DispatchProfiler(const DispatchProfiler&) = delete;
+    DispatchProfiler& operator=(const DispatchProfiler&) = delete;
+
+    // needs the synchronization2 and hostQueryReset features, stays disabled (with a warning) if the queue family has no timestamps,
+    // get_calibrated_timestamps may be null, otherwise host_time_domain must be the clock behind std::chrono::steady_clock,
+    // count_invocations needs the pipelineStatisticsQuery feature
+    VkResult init(
+        VkDevice device,
+        float timestamp_period,
+        uint32_t timestamp_valid_bits,
+        uint32_t span_capacity,
+        PFN_vkGetCalibratedTimestampsKHR get_calibrated_timestamps,
+        VkTimeDomainKHR host_time_domain,
+        bool count_invocations
+    );
+    void destroy(); // before the device is destroyed
+    bool enabled() const;
+    void reset(); // on the host, the previous solve must have finished
+    uint32_t begin(VkCommandBuffer command_buffer, DispatchKind kind, const std::string& label, uint64_t byte_count); // NO_SPAN when full or off
+    void end(VkCommandBuffer command_buffer, uint32_t span);
+    // around everything recorded into a compute command buffer, a query can't span several
+    uint32_t begin_invocations(VkCommandBuffer command_buffer); // NO_SPAN when full or not counting
+    void end_invocations(VkCommandBuffer command_buffer, uint32_t query);
+    // once every recorded span has executed, origin is when the first span began on the host clock
+    VkResult collect(std::vector<DispatchTiming>& timings, std::chrono::steady_clock::time_point& origin);
+    VkResult collect_invocations(std::optional<uint64_t>& invocation_count); // empty unless counting
+};
+
+const char* dispatch_kind_name(DispatchKind kind);
+
+// one row per span and the total time of each kind, to tell whether solving or reducing dominates
+void print_dispatch_timings(const std::vector<DispatchTiming>& timings, std::ostream& output);
+void write_dispatch_timings_json(const std::vector<DispatchTiming>& timings, std::ostream& output);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+// streams text as a quoted json string, escaping quotes, backslashes and control characters,
+// for the labels and names the json writers take from elsewhere: output << JsonString{label}
+struct JsonString {
+    std::string_view text;
+};
+
+std::ostream& operator<<(std::ostream& output, JsonString string);
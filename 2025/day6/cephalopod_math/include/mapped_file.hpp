@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+// read-only memory mapping of an entire file, the mapping lives until close() or destruction
+class MappedFile {
+private:
+    const char* bytes;
+    size_t length;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+    void close();
+
+    const char* data() const {
+        return this->bytes;
+    }
+
+    size_t size() const {
+        return this->length;
+    }
+};
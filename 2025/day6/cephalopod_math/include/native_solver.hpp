@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "worksheet.hpp"
+#include "cephalopod_engine.hpp"
+#include "worker_pool.hpp"
+
+// solves the worksheet on the host with the pool's threads (avx2 lanes for the wrapping arithmetic where available),
+// takes the same moduli as the vulkan path and fills the total exactly like it
+void solve_native(const Worksheet& worksheet, bool wide, const std::vector<uint32_t>& moduli, WorkerPool& worker_pool, SolveTotal& total);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// parses up to capacity space-padded decimal numbers from [cursor, end) into values, returns how many were parsed
+// and leaves cursor just past the last digit consumed so parsing can resume where it left off
+using NumberParser = size_t (*)(const char*& cursor, const char* end, uint32_t* values, size_t capacity);
+
+size_t parse_numbers_scalar(const char*& cursor, const char* end, uint32_t* values, size_t capacity);
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define NUMBER_PARSER_X86
+    size_t parse_numbers_sse41(const char*& cursor, const char* end, uint32_t* values, size_t capacity);
+    size_t parse_numbers_avx2(const char*& cursor, const char* end, uint32_t* values, size_t capacity);
+    bool cpu_supports_avx2(); // also checks that the os saves the ymm registers
+#endif
+
+NumberParser select_number_parser(); // picks the widest kernel the cpu supports
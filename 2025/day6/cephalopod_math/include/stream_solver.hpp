@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// solves the worksheet in a single pass over its rows, keeping one running total per problem instead of the whole file,
+// path "-" reads from stdin, returns false if the input can't be read
+bool solve_streaming(const char* path, uint64_t& result);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// a timeline of host and device spans in chrome trace event format (chrome://tracing, ui.perfetto.dev),
+// nothing is recorded until tracing is enabled so the spans cost one relaxed load otherwise
+void enable_tracing();
+bool tracing_enabled();
+// on the calling thread's track, spans on one thread must nest
+void trace_span(const char* name, const char* category, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+// on the gpu's track, begin already moved onto the host clock
+void trace_device_span(const std::string& name, const char* category, std::chrono::steady_clock::time_point begin, double duration_ms);
+bool write_trace(const char* path);
+
+// a span from construction to the end of the enclosing scope
+class TraceScope {
+private:
+    const char* name;
+    const char* category;
+    std::chrono::steady_clock::time_point begin;
+
+public:
+    TraceScope(const char* name, const char* category);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_SCOPE(label, name, category) TraceScope label(name, category)
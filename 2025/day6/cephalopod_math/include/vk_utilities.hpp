@@ -14,6 +14,15 @@
     } \
 }
 
+// like VK_CHECK but hands the failing result back to the caller, for functions that themselves return a VkResult
+#define VK_TRY(result) { \
+    VkResult _result = result; \
+    if (_result != VK_SUCCESS) { \
+        std::cout << "error on line " << __LINE__ << ": " << string_VkResult(_result) << std::endl; \
+        return _result; \
+    } \
+}
+
 VkResult create_vulkan_instance(
     const char* app_name,
     uint32_t app_version,
@@ -23,6 +32,9 @@ VkResult create_vulkan_instance(
     VkInstance& instance
 );
 VkPhysicalDevice pick_physical_device(VkInstance instance, uint32_t score_gpu(VkPhysicalDevice gpu));
+bool supports_device_extension(VkPhysicalDevice gpu, const char* extension_name);
+// the calibrated timestamps extension (khr, else ext) if the gpu can sample its own clock together with host_time_domain, nullptr otherwise
+const char* find_calibrated_timestamps_extension(VkInstance instance, VkPhysicalDevice gpu, VkTimeDomainKHR host_time_domain);
 VkResult create_logical_device(
     VkPhysicalDevice gpu,
     const std::vector<VkDeviceQueueCreateInfo>& queue_create_infos,
@@ -40,12 +52,26 @@ VkResult create_pipeline_layout(
 );
 VkResult create_compute_pipeline(
     VkDevice device,
+    VkPipelineCache pipeline_cache,
     VkPipelineLayout pipeline_layout,
     VkShaderModule shader_module,
     const char* entrypoint,
     const VkSpecializationInfo* specialization_info,
     VkPipeline& pipeline
 );
+// starts empty when the file is missing or was written by a different device or driver version
+VkResult create_pipeline_cache_from_file(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& gpu_properties,
+    const char* path,
+    VkPipelineCache& pipeline_cache
+);
+VkResult save_pipeline_cache_to_file(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& gpu_properties,
+    VkPipelineCache pipeline_cache,
+    const char* path
+);
 VkResult create_command_pool(VkDevice device, VkCommandPoolCreateFlags flags, uint32_t queue_family_index, VkCommandPool& command_pool);
 VkResult allocate_command_buffer(
     VkDevice device,
@@ -54,6 +80,8 @@ VkResult allocate_command_buffer(
     VkCommandBuffer& command_buffer
 );
 VkResult create_fence(VkDevice device, bool create_signalled, VkFence& fence);
+VkResult create_timeline_semaphore(VkDevice device, uint64_t initial_value, VkSemaphore& semaphore);
+VkResult wait_timeline_semaphore(VkDevice device, VkSemaphore semaphore, uint64_t value, uint64_t timeout);
 VkResult begin_command_buffer(
     VkCommandBuffer command_buffer,
     VkCommandBufferUsageFlags usage_flags,
@@ -67,3 +95,20 @@ VkResult submit_command_buffer(
     const std::vector<VkSemaphore>& signal_semaphores,
     VkFence fence
 );
+// like submit_command_buffer but every semaphore is a timeline semaphore with the matching wait or signal value
+VkResult submit_command_buffer_timeline(
+    VkQueue queue,
+    VkCommandBuffer command_buffer,
+    const std::vector<VkSemaphore>& wait_semaphores,
+    const std::vector<uint64_t>& wait_values,
+    const std::vector<VkPipelineStageFlags>& wait_dst_stage_masks,
+    const std::vector<VkSemaphore>& signal_semaphores,
+    const std::vector<uint64_t>& signal_values
+);
+void record_memory_barrier(
+    VkCommandBuffer command_buffer,
+    VkPipelineStageFlags src_stage_mask,
+    VkPipelineStageFlags dst_stage_mask,
+    VkAccessFlags src_access_mask,
+    VkAccessFlags dst_access_mask
+);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// same bytes as the uvec4 results of the wide shaders (32-bit limbs, least significant first) on a little endian host
+struct alignas(16) UInt128 {
+    uint64_t low;
+    uint64_t high;
+
+    bool add(const UInt128& other); // returns whether the sum carried out of the top limb, the result wraps like the gpu's
+    bool multiply(uint32_t factor); // same for the product
+    std::string to_string() const; // in decimal
+};
+
+// arbitrary precision, only as much as exact solves need to build their result and print it
+struct BigUInt {
+    std::vector<uint32_t> limbs; // least significant first, no leading zero limbs (zero is empty)
+
+    void multiply_add(uint32_t factor, uint32_t addend); // this = this * factor + addend
+    std::string to_string() const; // in decimal
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads started once and woken for every batch of tasks, so a solve doesn't pay for creating and joining them,
+// the thread calling run() is one of the workers and only one batch runs at a time
+class WorkerPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable batch_ready;
+    std::condition_variable batch_done;
+    const std::function<void(size_t)>* run_task = nullptr; // the current batch, guarded by mutex like the fields below
+    size_t task_count = 0;
+    size_t batch = 0; // bumped for every batch, a worker takes part in each one exactly once
+    size_t finished_count = 0; // workers done with the current batch
+    bool stopping = false;
+    std::atomic<size_t> next_task = 0;
+
+    void work(); // a worker thread's loop
+    void take_tasks(); // until there are none left in the current batch
+
+public:
+    WorkerPool() = default;
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start(size_t thread_count); // 0 uses every core, does nothing once started
+    void stop();
+    size_t thread_count() const; // the calling thread included
+    void run(size_t task_count, const std::function<void(size_t)>& run_task); // returns once every task ran
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum ProblemLayout : uint32_t {
+    PROBLEM_MAJOR = 0, // each problem's values are contiguous (array of structures)
+    VALUE_MAJOR = 1 // the i-th values of every problem are contiguous (structure of arrays)
+};
+
+// distances in elements between the values of a region holding problem_count problems
+struct ProblemStrides {
+    size_t problem_stride; // between the first values of neighbouring problems
+    size_t value_stride; // between neighbouring values of the same problem
+
+    static ProblemStrides of(ProblemLayout layout, size_t problem_count, size_t values_per_problem);
+};
+
+// words of an op mask, bit i % 32 of word i / 32 is set when problem i is a product
+size_t op_mask_word_count(size_t problem_count);
+
+// a run of consecutive problems in file order, the unit the pipelined solve parses, uploads and solves at a time
+struct WorksheetChunk {
+    size_t add_problem_count;
+    size_t mul_problem_count;
+
+    size_t total_problem_count() const;
+};
+
+// where parsing stopped in every row, so the problems can be filled one chunk after another
+struct WorksheetCursor {
+    std::vector<const char*> rows;
+    const char* op;
+};
+
+// views into the raw worksheet text, nothing is copied so the text must outlive the worksheet
+struct Worksheet {
+    std::vector<std::string_view> rows; // one line of values per row, every problem takes one value from each row
+    std::string_view ops; // the last line, one operator per problem
+    size_t add_problem_count;
+    size_t mul_problem_count;
+
+    static Worksheet scan(const char* text, size_t text_size);
+    size_t total_problem_count() const;
+    size_t values_per_problem() const;
+    std::string_view values_text() const; // every value row, from the start of the first to the end of the last
+    WorksheetChunk whole() const;
+    std::vector<WorksheetChunk> split(size_t max_problems_per_chunk) const;
+    WorksheetCursor begin() const;
+
+    // tokenizes the rows in place with the fastest available parser and writes each problem's values into its operator's region
+    void fill_problems(uint32_t* add_problems, uint32_t* mul_problems, ProblemLayout layout) const;
+
+    // same for just the chunk starting at the cursor, the regions are sized for that chunk and the cursor is moved past it
+    void fill_problems(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* add_problems, uint32_t* mul_problems, ProblemLayout layout) const;
+
+    // like fill_problems but keeps the chunk's problems in file order in one region, with their operators in an op mask
+    void fill_problems_in_order(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* problems, uint32_t* op_mask, ProblemLayout layout) const;
+
+    // just the op mask of the chunk starting at the cursor, moves only the cursor's operator past the chunk
+    void fill_op_mask(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* op_mask) const;
+
+    // for the gpu tokenizer, writes the index of each problem (in file order) within the add then mul problem regions
+    void fill_problem_slots(uint32_t* problem_slots) const;
+};
+
+enum ValueDistribution : uint32_t {
+    UNIFORM_DIGIT_COUNT = 0, // every length is equally likely, like the puzzle input
+    UNIFORM_VALUE = 1 // every value is equally likely, so almost all of them have the maximum length
+};
+
+// what generate_worksheet makes, the same shape (seed included) always gives the same text
+struct WorksheetShape {
+    size_t problem_count;
+    size_t values_per_problem;
+    size_t min_digits = 1;
+    size_t max_digits = 4; // at most 9 so every value fits in 32 bits
+    ValueDistribution value_distribution = ValueDistribution::UNIFORM_DIGIT_COUNT;
+    double mul_fraction = 0.5; // of the problems, the rest are additions
+    uint64_t seed = 0;
+};
+
+// a random worksheet in the puzzle's format, every problem's column is max_digits wide with its values left aligned
+std::string generate_worksheet(const WorksheetShape& shape);
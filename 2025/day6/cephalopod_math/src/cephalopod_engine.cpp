@@ -0,0 +1,1897 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "housekeeper.hpp"
+#include "vk_utilities.hpp"
+#include "struct_builder.hpp"
+#include "worksheet.hpp"
+#include "wide_integer.hpp"
+#include "crt.hpp"
+#include "native_solver.hpp"
+#include "dispatch_profiler.hpp"
+#include "trace.hpp"
+#include "json_string.hpp"
+#include "cephalopod_engine.hpp"
+
+const uint32_t WORKGROUP_SIZE = 256;
+const uint32_t MAX_UNROLLED_VALUES_PER_PROBLEM = 8; // taller worksheets use the pipeline that reads the count from push constants
+const size_t SLOT_ALIGNMENT = 256; // keeps neighbouring chunks of the working buffer off each other's cache lines
+const double MEMORY_BUDGET_SHARE = 0.5; // of what a heap has left, the rest is headroom for the driver and other processes
+const uint32_t PARSE_BYTES_PER_INVOCATION = 16;
+const uint32_t PARSE_BYTES_PER_WORKGROUP = WORKGROUP_SIZE * PARSE_BYTES_PER_INVOCATION;
+
+enum Opcode : uint32_t {
+    ADD = 0,
+    MUL = 1,
+    COMBINE_RESULTS = 2,
+    ADD_AND_COMBINE = 3,
+    MUL_AND_COMBINE = 4,
+    MIXED = 5, // both operators in one dispatch, see EngineConfig::mixed
+    MIXED_AND_COMBINE = 6
+};
+
+enum Arithmetic : uint32_t {
+    WRAPPING = 0,
+    WIDE = 1,
+    MODULAR = 2
+};
+
+// specialization constants of cephalopod_math and sum_results, in constant_id order
+struct MathSpecialization {
+    uint32_t workgroup_size;
+    uint32_t opcode;
+    uint32_t values_per_problem;
+    uint32_t arithmetic;
+};
+
+struct PushConstants {
+    uint64_t data_in_ptr;
+    uint64_t data_out_ptr;
+    uint64_t problem_stride;
+    uint64_t value_stride;
+    uint32_t problem_count; // of one dispatch, record_dispatch_problems splits larger counts and rebases the pointers
+    uint32_t value_count;
+    uint64_t overflow_ptr;
+    uint32_t modulus;
+    uint32_t montgomery_inverse;
+    uint32_t montgomery_fixup;
+    uint64_t op_mask_ptr; // mixed pipelines only, advanced along with data_in_ptr
+};
+
+// push constants of the modular pipelines, all zero otherwise
+struct ModularConstants {
+    uint32_t modulus;
+    uint32_t montgomery_inverse;
+    uint32_t montgomery_fixup;
+
+    static ModularConstants of(uint32_t modulus, size_t values_per_problem) {
+        if (modulus == 0) return ModularConstants{};
+
+        // newton's iteration doubles the correct low bits of the inverse each step, an odd modulus is its own inverse mod 8
+        uint32_t inverse = modulus;
+        for (int step = 0; step < 4; step++) inverse *= 2 - modulus * inverse;
+
+        // every product step multiplies by 2^-32, one more reduction by 2^32 * 2^(32 * values_per_problem) cancels them all
+        uint64_t r = (uint64_t(1) << 32) % modulus;
+        uint64_t fixup = r;
+        for (size_t step = 0; step < values_per_problem; step++) fixup = fixup * r % modulus;
+
+        return ModularConstants{
+            .modulus = modulus,
+            .montgomery_inverse = 0 - inverse,
+            .montgomery_fixup = static_cast<uint32_t>(fixup)
+        };
+    }
+};
+
+enum ParseOpcode : uint32_t {
+    COUNT_TOKENS = 0,
+    SCAN_BLOCKS = 1,
+    SCATTER_TOKENS = 2,
+    COUNT_PRODUCTS = 3, // the partition passes, see EngineConfig::gpu_partition
+    SCAN_PRODUCT_BLOCKS = 4,
+    PARTITION_PROBLEMS = 5,
+    FIND_ROW_TOKENS = 6
+};
+
+const uint32_t PARTITION_PROBLEMS_PER_WORKGROUP = WORKGROUP_SIZE * 32; // an op mask word per invocation
+
+// byte offsets of one chunk's regions, relative to wherever the chunk is placed in the working buffer,
+// a mixed chunk keeps every problem and result in the add regions in file order and leaves the mul regions empty
+struct ChunkLayout {
+    size_t op_mask_offset; // mixed only, first so the gpu tokenizer's upload can take it along with the text
+    size_t add_problems_offset;
+    size_t mul_problems_offset;
+    size_t upload_size; // just the problems and op mask, everything the host writes
+    size_t add_results_offset;
+    size_t mul_results_offset; // directly follows the add results
+    size_t result_count;
+    size_t scratch_offset;
+    size_t total_size;
+
+    static ChunkLayout of(const WorksheetChunk& chunk, size_t values_per_problem, bool fused, bool atomic_reduction, bool wide, bool mixed) {
+        size_t add_problem_count = mixed ? chunk.total_problem_count() : chunk.add_problem_count;
+        size_t mul_problem_count = mixed ? 0 : chunk.mul_problem_count;
+
+        // fused kernels leave one partial sum per workgroup instead of one result per problem
+        size_t add_result_count = fused ? (add_problem_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE : add_problem_count;
+        size_t mul_result_count = fused ? (mul_problem_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE : mul_problem_count;
+
+        ChunkLayout layout{};
+        StructBuilder struct_builder;
+        layout.op_mask_offset = struct_builder.add<uint32_t>(mixed ? op_mask_word_count(add_problem_count) : 0);
+        layout.add_problems_offset = struct_builder.add<uint32_t>(add_problem_count * values_per_problem);
+        layout.mul_problems_offset = struct_builder.add<uint32_t>(mul_problem_count * values_per_problem);
+        layout.upload_size = struct_builder.total_size();
+        layout.result_count = add_result_count + mul_result_count;
+        if (wide) {
+            layout.add_results_offset = struct_builder.add<UInt128>(add_result_count);
+            layout.mul_results_offset = struct_builder.add<UInt128>(mul_result_count);
+            layout.scratch_offset = struct_builder.add<UInt128>(layout.result_count); // never reduced atomically
+        } else {
+            layout.add_results_offset = struct_builder.add<uint64_t>(add_result_count);
+            layout.mul_results_offset = struct_builder.add<uint64_t>(mul_result_count);
+            layout.scratch_offset = struct_builder.add<uint64_t>(atomic_reduction ? 1 : layout.result_count); // the atomic reduction only needs the total
+        }
+        layout.total_size = struct_builder.total_size();
+        return layout;
+    }
+};
+
+struct ParsePushConstants {
+    uint64_t text_ptr;
+    uint64_t block_offsets_ptr;
+    uint64_t problem_slots_ptr;
+    uint64_t problems_ptr;
+    uint32_t text_size;
+    uint32_t problem_count;
+    uint32_t add_problem_count;
+    uint32_t values_per_problem;
+    uint32_t block_count;
+    uint32_t problem_layout;
+    uint32_t opcode;
+    uint64_t op_mask_ptr;
+    uint64_t product_block_offsets_ptr;
+    uint32_t product_block_count;
+    uint64_t row_starts_ptr;
+    uint64_t row_token_offsets_ptr;
+};
+
+uint32_t calculate_gpu_score(VkPhysicalDevice gpu);
+bool load_crossover(const std::string& path, size_t& crossover);
+double lap(std::chrono::steady_clock::time_point& lap_begin, const char* phase);
+void save_crossover(const std::string& path, size_t crossover);
+bool supports_atomic_reduction(VkPhysicalDevice gpu);
+void record_parse_worksheet_routine(
+    VkCommandBuffer command_buffer,
+    VkPipelineLayout pipeline_layout,
+    VkBuffer buffer,
+    VkDeviceAddress buffer_address,
+    size_t text_size,
+    size_t problem_count,
+    size_t add_problem_count,
+    size_t values_per_problem,
+    ProblemLayout problem_layout,
+    size_t text_offset,
+    size_t block_offsets_offset,
+    size_t problem_slots_offset,
+    size_t problems_offset,
+    size_t row_starts_offset,
+    size_t row_token_offsets_offset,
+    bool partition, // fills the problem slots from the op mask first
+    size_t op_mask_offset,
+    size_t product_block_offsets_offset,
+    DispatchProfiler& profiler
+);
+VkResult create_math_pipeline(
+    VkDevice device,
+    VkPipelineCache pipeline_cache,
+    VkPipelineLayout pipeline_layout,
+    VkShaderModule shader_module,
+    const MathSpecialization& specialization,
+    VkPipeline& pipeline
+);
+void record_dispatch_problems(
+    VkCommandBuffer command_buffer,
+    VkPipelineLayout pipeline_layout,
+    PushConstants push_constants,
+    size_t problem_count,
+    size_t in_bytes_per_problem,
+    size_t out_bytes_per_workgroup,
+    uint32_t max_workgroup_count
+);
+void record_solve_math_problems_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkDeviceAddress buffer_address,
+    const ProblemStrides& strides,
+    size_t values_per_problem,
+    size_t problem_count,
+    size_t problems_offset,
+    size_t results_offset,
+    size_t result_size,
+    VkDeviceAddress overflow_address,
+    VkDeviceAddress op_mask_address,
+    const ModularConstants& modular,
+    bool fused,
+    uint32_t max_workgroup_count
+);
+size_t record_sum_results_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline combine_pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkDeviceAddress buffer_address,
+    size_t result_count,
+    size_t results_offset,
+    size_t scratch_offset,
+    size_t result_size,
+    VkDeviceAddress overflow_address,
+    const ModularConstants& modular,
+    uint32_t max_workgroup_count,
+    DispatchProfiler& profiler
+);
+size_t record_sum_results_atomic_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline sum_pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkBuffer buffer,
+    VkDeviceAddress buffer_address,
+    size_t result_count,
+    size_t results_offset,
+    size_t total_offset,
+    uint32_t max_workgroup_count
+);
+
+CephalopodEngine::~CephalopodEngine() {
+    if (this->device != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(this->device);
+        if (this->readback_buffer != VK_NULL_HANDLE) vmaDestroyBuffer(this->allocator, this->readback_buffer, this->readback_allocation);
+        if (this->staging_buffer != VK_NULL_HANDLE) vmaDestroyBuffer(this->allocator, this->staging_buffer, this->staging_allocation);
+        if (this->buffer != VK_NULL_HANDLE) vmaDestroyBuffer(this->allocator, this->buffer, this->buffer_allocation);
+        vkDestroySemaphore(this->device, this->transfer_timeline, nullptr); // destroying a null handle does nothing
+        vkDestroySemaphore(this->device, this->compute_timeline, nullptr);
+        vkDestroyCommandPool(this->device, this->transfer_command_pool, nullptr); // also frees any command buffers allocated from the pool
+        vkDestroyCommandPool(this->device, this->command_pool, nullptr); // also frees any command buffers allocated from the pool
+        vkDestroyPipeline(this->device, this->sum_pipeline, nullptr);
+        vkDestroyShaderModule(this->device, this->sum_shader, nullptr);
+        vkDestroyPipeline(this->device, this->parse_pipeline, nullptr);
+        vkDestroyPipelineLayout(this->device, this->parse_pipeline_layout, nullptr);
+        vkDestroyShaderModule(this->device, this->parse_shader, nullptr);
+        for (const auto& [key, math_pipeline] : this->math_pipelines) vkDestroyPipeline(this->device, math_pipeline, nullptr);
+        vkDestroyPipelineLayout(this->device, this->pipeline_layout, nullptr);
+        vkDestroyShaderModule(this->device, this->math_shader, nullptr);
+        if (this->pipeline_cache != VK_NULL_HANDLE && !this->config.pipeline_cache_path.empty()) {
+            save_pipeline_cache_to_file(this->device, this->gpu_properties, this->pipeline_cache, this->config.pipeline_cache_path.c_str());
+        }
+        vkDestroyPipelineCache(this->device, this->pipeline_cache, nullptr);
+        this->profiler.destroy();
+        if (this->allocator != VK_NULL_HANDLE) vmaDestroyAllocator(this->allocator);
+        vkDestroyDevice(this->device, nullptr);
+    }
+
+    vkDestroyInstance(this->instance, nullptr);
+}
+
+std::string CephalopodEngine::shader_path(const char* name) const {
+    return this->config.shader_directory + "/" + name;
+}
+
+VkResult CephalopodEngine::init(const EngineConfig& config) {
+    this->config = config;
+    if (config.collect_metrics) this->config.profile_dispatches = true; // the kernel bandwidths come from the dispatch timings
+    if (config.modulus != 0 && (config.modulus % 2 == 0 || config.modulus < 3 || config.modulus >= (1u << 31))) {
+        std::cout << "the modulus must be odd, at least 3 and below 2^31" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    if (int(config.wide) + int(config.modulus != 0) + int(config.exact) > 1) {
+        std::cout << "wide, modular and exact arithmetic are mutually exclusive" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (config.backend != Backend::VULKAN) this->worker_pool.start(config.thread_count);
+
+    // the auto backend only brings vulkan up once a worksheet is large enough to need it
+    return config.backend == Backend::VULKAN ? this->init_vulkan() : VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::init_vulkan() {
+    TRACE_SCOPE(trace, "init_vulkan", "startup");
+    std::chrono::steady_clock::time_point startup_begin = std::chrono::steady_clock::now();
+    const EngineConfig& config = this->config;
+    VK_TRY(create_vulkan_instance(
+        "AoC 2025 - Day 6 Part 1",
+        VK_MAKE_API_VERSION(0, 1, 0, 0),
+        VK_API_VERSION_1_3,
+        {}, {},
+        this->instance
+    ));
+
+    this->gpu = pick_physical_device(this->instance, calculate_gpu_score);
+    if (this->gpu == VK_NULL_HANDLE) {
+        std::cout << "no suitable gpu found" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    vkGetPhysicalDeviceProperties(this->gpu, &this->gpu_properties);
+    if (this->gpu_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU && !config.allow_cpu_device) { // only ever picked when there's no gpu
+        std::cout << "no suitable gpu found, only the cpu implementation " << this->gpu_properties.deviceName << " (allow it with --allow-cpu-device)" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    this->max_workgroup_count = std::min(this->gpu_properties.limits.maxComputeWorkGroupCount[0], UINT32_MAX / WORKGROUP_SIZE);
+
+    this->queue_family_indices = QueueFamilyIndices::find(this->gpu);
+    if (!this->queue_family_indices.is_complete()) {
+        std::cout << "unable to find all required queue families" << std::endl;
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    this->atomic_reduction = !config.tree_reduction && !config.wide && supports_atomic_reduction(this->gpu); // there are no 128-bit atomics
+
+    // shader invocations are counted with pipeline statistics queries, an optional feature
+    VkPhysicalDeviceFeatures2 supported_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = nullptr
+    };
+    vkGetPhysicalDeviceFeatures2(this->gpu, &supported_features);
+    bool count_invocations = config.collect_metrics && supported_features.features.pipelineStatisticsQuery == VK_TRUE;
+
+    // timestamps need vkCmdWriteTimestamp2 and resetting the query pool from the host, both core in 1.3
+    VkPhysicalDeviceHostQueryResetFeatures enabled_host_query_reset_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES,
+        .pNext = nullptr,
+        .hostQueryReset = config.profile_dispatches ? VK_TRUE : VK_FALSE
+    };
+
+    VkPhysicalDeviceSynchronization2Features enabled_synchronization2_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+        .pNext = &enabled_host_query_reset_features,
+        .synchronization2 = config.profile_dispatches ? VK_TRUE : VK_FALSE
+    };
+
+    VkPhysicalDeviceShaderSubgroupExtendedTypesFeatures enabled_subgroup_extended_types_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_SUBGROUP_EXTENDED_TYPES_FEATURES,
+        .pNext = &enabled_synchronization2_features,
+        .shaderSubgroupExtendedTypes = this->atomic_reduction ? VK_TRUE : VK_FALSE
+    };
+
+    VkPhysicalDeviceShaderAtomicInt64Features enabled_atomic_int64_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES,
+        .pNext = &enabled_subgroup_extended_types_features,
+        .shaderBufferInt64Atomics = this->atomic_reduction ? VK_TRUE : VK_FALSE,
+        .shaderSharedInt64Atomics = VK_FALSE
+    };
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabled_timeline_semaphore_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .pNext = &enabled_atomic_int64_features,
+        .timelineSemaphore = VK_TRUE
+    };
+
+    VkPhysicalDeviceBufferDeviceAddressFeatures enabled_bda_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+        .pNext = &enabled_timeline_semaphore_features,
+        .bufferDeviceAddress = VK_TRUE
+    };
+
+    VkPhysicalDeviceFeatures2 enabled_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &enabled_bda_features,
+        .features = {
+            .pipelineStatisticsQuery = count_invocations ? VK_TRUE : VK_FALSE,
+            .shaderInt64 = VK_TRUE
+        }
+    };
+
+    // without it vma can only estimate the heap budgets from its own allocations
+    bool memory_budget_supported = supports_device_extension(this->gpu, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    std::vector<const char*> enabled_extensions;
+    if (memory_budget_supported) enabled_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // lines the dispatch timestamps up with the host's spans in a trace, steady_clock is CLOCK_MONOTONIC on linux,
+    // elsewhere the profiler estimates the offset instead
+    const char* calibrated_timestamps_extension = nullptr;
+#ifdef __linux__
+    if (config.profile_dispatches) calibrated_timestamps_extension = find_calibrated_timestamps_extension(this->instance, this->gpu, VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR);
+    if (calibrated_timestamps_extension != nullptr) enabled_extensions.push_back(calibrated_timestamps_extension);
+#endif
+
+    VK_TRY(create_logical_device(
+        this->gpu,
+        this->queue_family_indices.make_queue_create_infos(),
+        enabled_features,
+        enabled_extensions,
+        this->device
+    ));
+    this->queues = this->queue_family_indices.get_queues(this->device);
+
+    {
+        VmaAllocatorCreateInfo create_info{};
+        create_info.vulkanApiVersion = VK_API_VERSION_1_3;
+        create_info.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+        if (memory_budget_supported) create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        create_info.instance = this->instance;
+        create_info.physicalDevice = this->gpu;
+        create_info.device = this->device;
+        VK_TRY(vmaCreateAllocator(&create_info, &this->allocator));
+    }
+
+    if (config.profile_dispatches) {
+        PFN_vkGetCalibratedTimestampsKHR get_calibrated_timestamps = nullptr;
+        if (calibrated_timestamps_extension != nullptr) {
+            bool is_khr = std::strcmp(calibrated_timestamps_extension, VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0;
+            get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsKHR>(
+                vkGetDeviceProcAddr(this->device, is_khr ? "vkGetCalibratedTimestampsKHR" : "vkGetCalibratedTimestampsEXT")
+            );
+        }
+
+        VK_TRY(this->profiler.init(
+            this->device,
+            this->gpu_properties.limits.timestampPeriod,
+            this->queue_family_indices.compute_timestamp_valid_bits,
+            DISPATCH_SPAN_CAPACITY,
+            get_calibrated_timestamps,
+            VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR,
+            count_invocations
+        ));
+    }
+
+    if (!config.pipeline_cache_path.empty()) { // without a cache every start recompiles the shaders from spir-v
+        VK_TRY(create_pipeline_cache_from_file(this->device, this->gpu_properties, config.pipeline_cache_path.c_str(), this->pipeline_cache));
+    }
+
+    VK_TRY(create_shader_module_from_file(this->device, this->shader_path("cephalopod_math.spv").c_str(), this->math_shader));
+
+    VkPushConstantRange push_constant_range{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(PushConstants)
+    };
+    VK_TRY(create_pipeline_layout(this->device, {}, {push_constant_range}, this->pipeline_layout));
+    std::vector<Opcode> opcodes = config.mixed
+        ? std::vector<Opcode>{Opcode::MIXED, Opcode::MIXED_AND_COMBINE, Opcode::COMBINE_RESULTS}
+        : std::vector<Opcode>{Opcode::ADD, Opcode::MUL, Opcode::COMBINE_RESULTS, Opcode::ADD_AND_COMBINE, Opcode::MUL_AND_COMBINE};
+    for (Opcode opcode : opcodes) {
+        VkPipeline math_pipeline;
+        VK_TRY(this->get_math_pipeline(opcode, 0, math_pipeline)); // the general variants up front, unrolled ones as worksheets need them
+    }
+
+    VK_TRY(create_shader_module_from_file(this->device, this->shader_path("parse_worksheet.spv").c_str(), this->parse_shader));
+
+    VkPushConstantRange parse_push_constant_range{
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(ParsePushConstants)
+    };
+    VK_TRY(create_pipeline_layout(this->device, {}, {parse_push_constant_range}, this->parse_pipeline_layout));
+    VK_TRY(create_compute_pipeline(this->device, this->pipeline_cache, this->parse_pipeline_layout, this->parse_shader, "main", nullptr, this->parse_pipeline));
+
+    if (this->atomic_reduction) { // the module declares 64-bit atomics, so only load it where they are supported
+        VK_TRY(create_shader_module_from_file(this->device, this->shader_path("sum_results.spv").c_str(), this->sum_shader));
+        MathSpecialization specialization{.workgroup_size = WORKGROUP_SIZE, .opcode = 0, .values_per_problem = 0, .arithmetic = Arithmetic::WRAPPING};
+        VK_TRY(create_math_pipeline(this->device, this->pipeline_cache, this->pipeline_layout, this->sum_shader, specialization, this->sum_pipeline));
+    }
+
+    VK_TRY(create_command_pool(
+        this->device,
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, // the command buffer is re-recorded for every solve
+        this->queue_family_indices.compute.value(),
+        this->command_pool
+    ));
+    for (VkCommandBuffer& command_buffer : this->compute_command_buffers) {
+        VK_TRY(allocate_command_buffer(this->device, this->command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, command_buffer));
+        // automatically freed when parent command pool is destroyed
+    }
+
+    VK_TRY(create_command_pool(
+        this->device,
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        this->queue_family_indices.transfer_or_compute(),
+        this->transfer_command_pool
+    ));
+    for (VkCommandBuffer& command_buffer : this->upload_command_buffers) {
+        VK_TRY(allocate_command_buffer(this->device, this->transfer_command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, command_buffer));
+    }
+    VK_TRY(allocate_command_buffer(this->device, this->transfer_command_pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, this->readback_command_buffer));
+
+    VK_TRY(create_timeline_semaphore(this->device, this->compute_timeline_value, this->compute_timeline));
+    VK_TRY(create_timeline_semaphore(this->device, this->transfer_timeline_value, this->transfer_timeline));
+    this->startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+    this->vulkan_ready = true;
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::reserve_buffer(size_t size) {
+    if (size <= this->buffer_capacity) return VK_SUCCESS;
+
+    if (this->buffer != VK_NULL_HANDLE) { // not in use, every solve waits for its work to finish
+        vmaDestroyBuffer(this->allocator, this->buffer, this->buffer_allocation);
+        this->buffer = VK_NULL_HANDLE;
+        this->buffer_allocation = VK_NULL_HANDLE;
+        this->buffer_capacity = 0;
+    }
+
+    if (this->staging_buffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(this->allocator, this->staging_buffer, this->staging_allocation);
+        this->staging_buffer = VK_NULL_HANDLE;
+        this->staging_allocation = VK_NULL_HANDLE;
+    }
+
+    // both queues touch the working buffer, sharing it concurrently saves ownership transfers around every copy
+    std::vector<uint32_t> queue_families = {this->queue_family_indices.compute.value()};
+    if (this->queue_family_indices.transfer.has_value()) queue_families.push_back(this->queue_family_indices.transfer.value());
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = queue_families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+    buffer_info.pQueueFamilyIndices = queue_families.data();
+
+    // vma only hands out mappable device local memory when it exists (rebar or a unified memory architecture),
+    // otherwise it picks plain device local memory and the staging buffer below is used instead
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT;
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    VK_TRY(vmaCreateBuffer(this->allocator, &buffer_info, &alloc_info, &this->buffer, &this->buffer_allocation, nullptr));
+    this->buffer_address = get_buffer_device_address(this->device, this->buffer);
+    this->buffer_capacity = size;
+
+    VkMemoryPropertyFlags memory_properties;
+    vmaGetAllocationMemoryProperties(this->allocator, this->buffer_allocation, &memory_properties);
+    this->buffer_host_visible = (memory_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    if (this->buffer_host_visible) return VK_SUCCESS;
+
+    VkBufferCreateInfo staging_info{};
+    staging_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    staging_info.size = size;
+    staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    staging_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // only ever read by the transfer queue
+
+    VmaAllocationCreateInfo staging_alloc_info{};
+    staging_alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    staging_alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+
+    VK_TRY(vmaCreateBuffer(this->allocator, &staging_info, &staging_alloc_info, &this->staging_buffer, &this->staging_allocation, nullptr));
+
+    return VK_SUCCESS;
+}
+
+size_t CephalopodEngine::buffer_memory_budget() const {
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(this->allocator, &memory_properties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(this->allocator, budgets);
+
+    std::vector<size_t> available(memory_properties->memoryHeapCount);
+    for (uint32_t heap = 0; heap < memory_properties->memoryHeapCount; heap++) {
+        available[heap] = budgets[heap].budget > budgets[heap].usage ? budgets[heap].budget - budgets[heap].usage : 0;
+    }
+
+    // reserve_buffer frees the current buffers before growing them, so their memory counts as available too
+    auto heap_of = [&](VmaAllocation allocation) {
+        VmaAllocationInfo allocation_info;
+        vmaGetAllocationInfo(this->allocator, allocation, &allocation_info);
+        return memory_properties->memoryTypes[allocation_info.memoryType].heapIndex;
+    };
+    if (this->buffer_allocation != VK_NULL_HANDLE) available[heap_of(this->buffer_allocation)] += this->buffer_capacity;
+    if (this->staging_allocation != VK_NULL_HANDLE) available[heap_of(this->staging_allocation)] += this->buffer_capacity;
+
+    // vma puts the working buffer in the largest device local heap, and the staging buffer in the largest host heap
+    std::optional<uint32_t> device_heap, host_heap;
+    for (uint32_t heap = 0; heap < memory_properties->memoryHeapCount; heap++) {
+        std::optional<uint32_t>& largest = (memory_properties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 ? device_heap : host_heap;
+        if (!largest.has_value() || memory_properties->memoryHeaps[heap].size > memory_properties->memoryHeaps[largest.value()].size) largest = heap;
+    }
+    if (this->buffer_allocation != VK_NULL_HANDLE) device_heap = heap_of(this->buffer_allocation); // no need to guess
+    if (this->staging_allocation != VK_NULL_HANDLE) host_heap = heap_of(this->staging_allocation);
+    if (!device_heap.has_value()) device_heap = host_heap; // no device local heap at all, everything lives in host memory
+
+    size_t budget = available[device_heap.value()];
+    bool staged = host_heap.has_value() && (this->buffer_allocation != VK_NULL_HANDLE ? !this->buffer_host_visible : host_heap != device_heap);
+    if (staged) { // the staging buffer mirrors the working buffer byte for byte
+        budget = host_heap == device_heap ? budget / 2 : std::min(budget, available[host_heap.value()]);
+    }
+
+    return static_cast<size_t>(budget * MEMORY_BUDGET_SHARE);
+}
+
+VkResult CephalopodEngine::get_math_pipeline(uint32_t opcode, uint32_t values_per_problem, VkPipeline& pipeline) {
+    if (opcode == Opcode::COMBINE_RESULTS || values_per_problem > MAX_UNROLLED_VALUES_PER_PROBLEM) values_per_problem = 0;
+
+    auto [entry, inserted] = this->math_pipelines.try_emplace({opcode, values_per_problem}, VK_NULL_HANDLE);
+    if (inserted) {
+        MathSpecialization specialization{
+            .workgroup_size = WORKGROUP_SIZE,
+            .opcode = opcode,
+            .values_per_problem = values_per_problem,
+            .arithmetic = this->config.wide ? Arithmetic::WIDE
+                : this->config.modulus != 0 || this->config.exact ? Arithmetic::MODULAR
+                : Arithmetic::WRAPPING
+        };
+        VkResult result = create_math_pipeline(this->device, this->pipeline_cache, this->pipeline_layout, this->math_shader, specialization, entry->second);
+        if (result != VK_SUCCESS) {
+            this->math_pipelines.erase(entry);
+            return result;
+        }
+    }
+
+    pipeline = entry->second;
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::get_solve_pipelines(size_t values_per_problem, VkPipeline& add_pipeline, VkPipeline& mul_pipeline) {
+    const EngineConfig& config = this->config;
+    uint32_t unrolled_value_count = static_cast<uint32_t>(values_per_problem);
+    if (config.mixed) {
+        mul_pipeline = VK_NULL_HANDLE;
+        return this->get_math_pipeline(config.fused ? Opcode::MIXED_AND_COMBINE : Opcode::MIXED, unrolled_value_count, add_pipeline);
+    }
+
+    VK_TRY(this->get_math_pipeline(config.fused ? Opcode::ADD_AND_COMBINE : Opcode::ADD, unrolled_value_count, add_pipeline));
+    return this->get_math_pipeline(config.fused ? Opcode::MUL_AND_COMBINE : Opcode::MUL, unrolled_value_count, mul_pipeline);
+}
+
+VkResult CephalopodEngine::reserve_readback_buffer(size_t size) {
+    if (size <= this->readback_capacity) return VK_SUCCESS;
+
+    if (this->readback_buffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(this->allocator, this->readback_buffer, this->readback_allocation);
+        this->readback_buffer = VK_NULL_HANDLE;
+        this->readback_allocation = VK_NULL_HANDLE;
+        this->readback_capacity = 0;
+    }
+
+    VkBufferCreateInfo readback_info{};
+    readback_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    readback_info.size = size;
+    readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readback_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // only ever written by the transfer queue
+
+    VmaAllocationCreateInfo readback_alloc_info{};
+    readback_alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT; // cached, the host reads it
+    readback_alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+
+    VK_TRY(vmaCreateBuffer(this->allocator, &readback_info, &readback_alloc_info, &this->readback_buffer, &this->readback_allocation, nullptr));
+    this->readback_capacity = size;
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::upload(size_t slot, size_t offset, size_t size, uint64_t& upload_value) {
+    VkCommandBuffer command_buffer = this->upload_command_buffers[slot];
+    VK_TRY(begin_command_buffer(command_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr));
+        VkBufferCopy region{.srcOffset = offset, .dstOffset = offset, .size = size}; // the staging buffer mirrors the working buffer
+        vkCmdCopyBuffer(command_buffer, this->staging_buffer, this->buffer, 1, &region);
+    VK_TRY(vkEndCommandBuffer(command_buffer));
+
+    upload_value = ++this->transfer_timeline_value;
+    return submit_command_buffer_timeline(this->queues.transfer, command_buffer, {}, {}, {}, {this->transfer_timeline}, {upload_value});
+}
+
+void CephalopodEngine::record_partial_sum(
+    VkCommandBuffer command_buffer,
+    VkPipeline combine_pipeline,
+    size_t result_count,
+    size_t results_offset,
+    size_t scratch_offset,
+    size_t partial_offset,
+    size_t overflow_offset,
+    uint32_t modulus
+) {
+    size_t result_size = this->result_size();
+    if (result_count == 0) { // nothing was solved, the partial sum is just zero
+        vkCmdFillBuffer(command_buffer, this->buffer, partial_offset, result_size, 0);
+    } else {
+        uint32_t atomic_span = this->atomic_reduction ? this->profiler.begin(command_buffer, DispatchKind::REDUCE, "atomic sum", result_count * result_size) : DispatchProfiler::NO_SPAN;
+        size_t total_offset = this->atomic_reduction
+            ? record_sum_results_atomic_routine(
+                command_buffer,
+                this->sum_pipeline,
+                this->pipeline_layout,
+                this->buffer,
+                this->buffer_address,
+                result_count,
+                results_offset,
+                scratch_offset,
+                this->max_workgroup_count
+            )
+            : record_sum_results_routine(
+                command_buffer,
+                combine_pipeline,
+                this->pipeline_layout,
+                this->buffer_address,
+                result_count,
+                results_offset,
+                scratch_offset,
+                result_size,
+                this->config.wide ? this->buffer_address + overflow_offset : 0,
+                ModularConstants::of(modulus, 0), // the reduction only adds
+                this->max_workgroup_count,
+                this->profiler
+            );
+        this->profiler.end(command_buffer, atomic_span);
+
+        record_memory_barrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT
+        );
+
+        uint32_t copy_span = this->profiler.begin(command_buffer, DispatchKind::REDUCE, "copy partial sum", result_size);
+        VkBufferCopy region{.srcOffset = total_offset, .dstOffset = partial_offset, .size = result_size};
+        vkCmdCopyBuffer(command_buffer, this->buffer, this->buffer, 1, &region);
+        this->profiler.end(command_buffer, copy_span);
+    }
+
+    if (this->buffer_host_visible) { // read straight out of the working buffer, otherwise the readback copy waits on a semaphore
+        record_memory_barrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // the overflow count is written by the shaders
+            VK_PIPELINE_STAGE_HOST_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_HOST_READ_BIT
+        );
+    }
+}
+
+void CephalopodEngine::record_solve_chunk(
+    VkCommandBuffer command_buffer,
+    VkPipeline add_pipeline,
+    VkPipeline mul_pipeline,
+    VkPipeline combine_pipeline,
+    const WorksheetChunk& chunk,
+    size_t values_per_problem,
+    size_t chunk_offset,
+    const std::vector<uint32_t>& moduli,
+    size_t partial_offset,
+    size_t partials_stride,
+    size_t overflow_offset
+) {
+    const EngineConfig& config = this->config;
+    ChunkLayout layout = ChunkLayout::of(chunk, values_per_problem, config.fused, this->atomic_reduction, config.wide, config.mixed);
+    VkDeviceAddress overflow_address = config.wide ? this->buffer_address + overflow_offset : 0;
+    size_t add_problem_count = config.mixed ? chunk.total_problem_count() : chunk.add_problem_count; // a mixed solve is one dispatch over every problem
+    this->record_overflow_reset(command_buffer, overflow_offset);
+
+    for (size_t modulus_index = 0; modulus_index < moduli.size(); modulus_index++) {
+        // the previous modulus has to be reduced and copied out before its results are overwritten,
+        // and its own writes to them made available so they can't land after the next modulus' writes
+        if (modulus_index > 0) {
+            record_memory_barrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+            );
+        }
+
+        ModularConstants modular = ModularConstants::of(moduli[modulus_index], values_per_problem);
+        std::string modulus_label = moduli.size() > 1 ? " mod " + std::to_string(moduli[modulus_index]) : "";
+        uint32_t add_span = this->profiler.begin(
+            command_buffer,
+            DispatchKind::SOLVE,
+            (config.mixed ? "mixed" : "add") + modulus_label,
+            add_problem_count * values_per_problem * sizeof(uint32_t) + (config.mixed ? op_mask_word_count(add_problem_count) * sizeof(uint32_t) : 0)
+        );
+        record_solve_math_problems_routine(
+            command_buffer,
+            add_pipeline,
+            this->pipeline_layout,
+            this->buffer_address,
+            ProblemStrides::of(config.problem_layout, add_problem_count, values_per_problem),
+            values_per_problem,
+            add_problem_count,
+            chunk_offset + layout.add_problems_offset,
+            chunk_offset + layout.add_results_offset,
+            this->result_size(),
+            overflow_address,
+            config.mixed ? this->buffer_address + chunk_offset + layout.op_mask_offset : 0,
+            modular,
+            config.fused,
+            this->max_workgroup_count
+        );
+        this->profiler.end(command_buffer, add_span);
+
+        if (!config.mixed) { // the mixed dispatch already solved the products
+            uint32_t mul_span = this->profiler.begin(command_buffer, DispatchKind::SOLVE, "mul" + modulus_label, chunk.mul_problem_count * values_per_problem * sizeof(uint32_t));
+            record_solve_math_problems_routine(
+                command_buffer,
+                mul_pipeline,
+                this->pipeline_layout,
+                this->buffer_address,
+                ProblemStrides::of(config.problem_layout, chunk.mul_problem_count, values_per_problem),
+                values_per_problem,
+                chunk.mul_problem_count,
+                chunk_offset + layout.mul_problems_offset,
+                chunk_offset + layout.mul_results_offset,
+                this->result_size(),
+                overflow_address,
+                0,
+                modular,
+                config.fused,
+                this->max_workgroup_count
+            );
+            this->profiler.end(command_buffer, mul_span);
+        }
+
+        this->record_partial_sum(
+            command_buffer,
+            combine_pipeline,
+            layout.result_count,
+            chunk_offset + layout.add_results_offset, // the mul results directly follow the add results
+            chunk_offset + layout.scratch_offset,
+            partial_offset + modulus_index * partials_stride,
+            overflow_offset,
+            moduli[modulus_index]
+        );
+    }
+}
+
+void CephalopodEngine::record_overflow_reset(VkCommandBuffer command_buffer, size_t overflow_offset) {
+    if (!this->config.wide) return;
+
+    vkCmdFillBuffer(command_buffer, this->buffer, overflow_offset, sizeof(uint32_t), 0);
+    record_memory_barrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+}
+
+size_t CephalopodEngine::result_size() const {
+    return this->config.wide ? sizeof(UInt128) : sizeof(uint64_t);
+}
+
+size_t CephalopodEngine::partials_size(size_t partial_count) const {
+    return partial_count * this->result_size() + (this->config.wide ? partial_count * sizeof(uint32_t) : 0);
+}
+
+VkResult CephalopodEngine::sum_partials(size_t partials_offset, size_t partial_count, const std::vector<uint32_t>& moduli, SolveTotal& total) {
+    // a staged readback waits for the last chunk on the gpu instead of the host, so it includes the tail of the solve
+    std::chrono::steady_clock::time_point lap_begin = std::chrono::steady_clock::now();
+    DEFER(time_readback, this->phase_timings.readback += lap(lap_begin, "readback"));
+
+    size_t partials_size = this->partials_size(partial_count * moduli.size());
+    VmaAllocation partials_allocation = this->buffer_allocation;
+    if (this->buffer_host_visible) {
+        VK_TRY(wait_timeline_semaphore(this->device, this->compute_timeline, this->compute_timeline_value, UINT64_MAX));
+        this->phase_timings.submit += lap(lap_begin, "submit");
+    } else {
+        VK_TRY(this->reserve_readback_buffer(partials_size));
+        VK_TRY(begin_command_buffer(this->readback_command_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr));
+            VkBufferCopy region{.srcOffset = partials_offset, .dstOffset = 0, .size = partials_size};
+            vkCmdCopyBuffer(this->readback_command_buffer, this->buffer, this->readback_buffer, 1, &region);
+            record_memory_barrier(
+                this->readback_command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_ACCESS_HOST_READ_BIT
+            );
+        VK_TRY(vkEndCommandBuffer(this->readback_command_buffer));
+
+        uint64_t readback_value = ++this->transfer_timeline_value;
+        VK_TRY(submit_command_buffer_timeline(
+            this->queues.transfer,
+            this->readback_command_buffer,
+            {this->compute_timeline}, {this->compute_timeline_value}, {VK_PIPELINE_STAGE_TRANSFER_BIT},
+            {this->transfer_timeline}, {readback_value}
+        ));
+        VK_TRY(wait_timeline_semaphore(this->device, this->transfer_timeline, readback_value, UINT64_MAX));
+
+        partials_allocation = this->readback_allocation;
+        partials_offset = 0;
+    }
+
+    VK_TRY(vmaInvalidateAllocation(this->allocator, partials_allocation, partials_offset, partials_size)); // does nothing for coherent memory
+
+    void* mapped_buffer;
+    VK_TRY(vmaMapMemory(this->allocator, partials_allocation, &mapped_buffer));
+    DEFER(unmap_buffer, vmaUnmapMemory(this->allocator, partials_allocation));
+
+    uintptr_t partials = reinterpret_cast<uintptr_t>(mapped_buffer) + partials_offset;
+    total = SolveTotal{};
+    if (this->config.wide) {
+        const UInt128* wide_partials = reinterpret_cast<const UInt128*>(partials);
+        const uint32_t* overflow_counts = reinterpret_cast<const uint32_t*>(partials + partial_count * sizeof(UInt128));
+        for (size_t index = 0; index < partial_count; index++) {
+            if (total.value.add(wide_partials[index])) total.overflow_count++;
+            total.overflow_count += overflow_counts[index];
+        }
+    } else {
+        const uint64_t* narrow_partials = reinterpret_cast<const uint64_t*>(partials);
+        for (size_t modulus_index = 0; modulus_index < moduli.size(); modulus_index++) {
+            uint64_t modulus = moduli[modulus_index];
+            uint64_t sum = 0;
+            for (size_t index = 0; index < partial_count; index++) {
+                uint64_t partial = narrow_partials[modulus_index * partial_count + index];
+                if (modulus != 0) sum = (sum + partial % modulus) % modulus; // the atomic reduction adds residues without reducing them
+                else sum += partial; // wraps exactly like the gpu sums
+            }
+            total.residues.push_back(sum);
+        }
+        total.value.low = total.residues[0];
+    }
+
+    return VK_SUCCESS;
+}
+
+const std::vector<DispatchTiming>& CephalopodEngine::last_dispatch_timings() const {
+    return this->dispatch_timings;
+}
+
+const SolveMetrics& CephalopodEngine::last_metrics() const {
+    return this->metrics;
+}
+
+std::optional<double> CephalopodEngine::vulkan_startup_ms() const {
+    return this->startup_ms;
+}
+
+const PhaseTimings& CephalopodEngine::last_phase_timings() const {
+    return this->phase_timings;
+}
+
+VkResult CephalopodEngine::solve(std::string_view worksheet_text, uint64_t& result) {
+    SolveTotal total;
+    VK_TRY(this->solve_total(worksheet_text, total));
+    result = total.value.low; // the wide total wraps to the same 64 bits the narrow one does
+    if (this->config.exact) { // and so does the exact one once it's rebuilt
+        BigUInt exact = crt_reconstruct(total.residues, crt_moduli(total.residues.size()));
+        result = 0;
+        for (size_t index = std::min<size_t>(exact.limbs.size(), 2); index-- > 0;) result = (result << 32) | exact.limbs[index];
+    }
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::solve_wide(std::string_view worksheet_text, UInt128& result, uint64_t& overflow_count) {
+    if (!this->config.wide) {
+        std::cout << "the engine wasn't initialized for wide arithmetic" << std::endl;
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    SolveTotal total;
+    VK_TRY(this->solve_total(worksheet_text, total));
+    result = total.value;
+    overflow_count = total.overflow_count;
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::solve_exact(std::string_view worksheet_text, BigUInt& result) {
+    if (!this->config.exact) {
+        std::cout << "the engine wasn't initialized for exact arithmetic" << std::endl;
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    SolveTotal total;
+    VK_TRY(this->solve_total(worksheet_text, total));
+    result = crt_reconstruct(total.residues, crt_moduli(total.residues.size()));
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::solve_total(std::string_view worksheet_text, SolveTotal& total) {
+    if (this->vulkan_ready) {
+        // a solve that failed part way may have left work in flight, it has to finish before the buffers are reused
+        VK_TRY(wait_timeline_semaphore(this->device, this->compute_timeline, this->compute_timeline_value, UINT64_MAX));
+        VK_TRY(wait_timeline_semaphore(this->device, this->transfer_timeline, this->transfer_timeline_value, UINT64_MAX));
+    }
+
+    std::chrono::steady_clock::time_point lap_begin = std::chrono::steady_clock::now();
+    Worksheet worksheet = Worksheet::scan(worksheet_text.data(), worksheet_text.size());
+    double parse_time = lap(lap_begin, "parse");
+
+    Backend backend = this->config.backend;
+    if (backend == Backend::AUTO) VK_TRY(this->choose_backend(worksheet.total_problem_count() * worksheet.values_per_problem(), backend));
+    this->phase_timings = PhaseTimings{.parse = parse_time}; // a calibration run on the way doesn't count
+    this->metrics = SolveMetrics{
+        .backend = backend,
+        .problem_count = worksheet.total_problem_count(),
+        .value_count = worksheet.total_problem_count() * worksheet.values_per_problem(),
+        .text_bytes = worksheet_text.size()
+    };
+    VK_TRY(this->solve_worksheet(worksheet, backend, this->moduli_for(worksheet), total));
+
+    // the calibration's time is left out here too, the phases say how long the solve itself took
+    this->metrics.phases = this->phase_timings;
+    const PhaseTimings& phases = this->phase_timings;
+    this->metrics.solve_ms = phases.parse + phases.layout + phases.fill + phases.record + phases.submit + phases.readback;
+    return VK_SUCCESS;
+}
+
+std::vector<uint32_t> CephalopodEngine::moduli_for(const Worksheet& worksheet) const {
+    if (!this->config.exact) return {this->config.modulus}; // zero for plain wrapping or wide arithmetic
+
+    // an exact solve needs enough primes that their product exceeds the largest possible total,
+    // every problem is below 2^(32 * values per problem) and there are fewer than 2^bit_width(problem count) of them
+    size_t total_bits = 32 * worksheet.values_per_problem() + std::bit_width(worksheet.total_problem_count());
+    return crt_moduli(total_bits / 30 + 1); // every prime is above 2^30
+}
+
+VkResult CephalopodEngine::solve_worksheet(const Worksheet& worksheet, Backend backend, const std::vector<uint32_t>& moduli, SolveTotal& total) {
+    if (backend == Backend::NATIVE) {
+        std::chrono::steady_clock::time_point lap_begin = std::chrono::steady_clock::now();
+        solve_native(worksheet, this->config.wide, moduli, this->worker_pool, total);
+        this->phase_timings.submit += lap(lap_begin, "submit"); // the host has nothing to submit, the whole solve is the work
+        return VK_SUCCESS;
+    }
+
+    this->profiler.reset();
+    this->profiler.scope.clear();
+    VK_TRY(this->config.gpu_parse
+        ? this->solve_gpu_parse(worksheet, moduli, total)
+        : this->solve_chunked(worksheet, moduli, total));
+
+    std::chrono::steady_clock::time_point device_origin;
+    VK_TRY(this->profiler.collect(this->dispatch_timings, device_origin)); // every chunk has been solved once the partial sums are back
+    for (const DispatchTiming& timing : this->dispatch_timings) {
+        std::chrono::duration<double, std::milli> start(timing.start_ms);
+        trace_device_span(timing.label, dispatch_kind_name(timing.kind), device_origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(start), timing.duration_ms);
+    }
+
+    if (!this->config.collect_metrics) return VK_SUCCESS;
+    for (const DispatchTiming& timing : this->dispatch_timings) {
+        std::optional<KernelMetrics>& kernel = this->metrics.kernels[timing.kind];
+        if (!kernel.has_value()) kernel = KernelMetrics{};
+        kernel->dispatch_count++;
+        kernel->ms += timing.duration_ms;
+        kernel->byte_count += timing.byte_count;
+    }
+    VK_TRY(this->profiler.collect_invocations(this->metrics.compute_invocation_count));
+
+    VmaTotalStatistics memory_statistics;
+    vmaCalculateStatistics(this->allocator, &memory_statistics);
+    this->metrics.memory = memory_statistics.total.statistics;
+    return VK_SUCCESS;
+}
+
+VkResult CephalopodEngine::choose_backend(size_t value_count, Backend& backend) {
+    if (!this->crossover.has_value()) {
+        size_t crossover;
+        if (this->config.crossover_path.empty() || !load_crossover(this->config.crossover_path, crossover)) {
+            VK_TRY(this->calibrate_crossover(crossover));
+            if (!this->config.crossover_path.empty()) save_crossover(this->config.crossover_path, crossover);
+        }
+
+        this->crossover = crossover;
+    }
+
+    // stderr, so the result stays the only thing a plain run prints
+    backend = value_count < *this->crossover ? Backend::NATIVE : Backend::VULKAN;
+    bool started_vulkan = backend == Backend::VULKAN && !this->vulkan_ready;
+    if (started_vulkan && this->init_vulkan() != VK_SUCCESS) {
+        std::cerr << "vulkan is unavailable, solving on the host from now on" << std::endl;
+        this->crossover = std::numeric_limits<size_t>::max(); // a failed init can't be retried on the same engine
+        backend = Backend::NATIVE;
+    }
+
+    std::cerr << "auto backend: " << value_count << " values, crossover at " << *this->crossover << ", solving on "
+        << (backend == Backend::NATIVE ? "the host" : this->gpu_properties.deviceName);
+    if (started_vulkan && this->startup_ms.has_value()) std::cerr << " (started vulkan in " << *this->startup_ms << " ms)";
+    std::cerr << std::endl;
+    return VK_SUCCESS;
+}
+
+// times the host on a generated worksheet, then vulkan's startup, a cold and a warm solve of a single problem and the same worksheet,
+// the crossover is where the host's cost per value has caught up with vulkan's fixed cost for a process that still has to start it
+VkResult CephalopodEngine::calibrate_crossover(size_t& crossover) {
+    TRACE_SCOPE(trace, "calibrate_crossover", "startup");
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    std::string tiny_text = generate_worksheet({.problem_count = 1, .values_per_problem = CALIBRATION_VALUES_PER_PROBLEM, .seed = 1});
+    std::string large_text = generate_worksheet({.problem_count = CALIBRATION_PROBLEM_COUNT, .values_per_problem = CALIBRATION_VALUES_PER_PROBLEM, .seed = 2});
+    Worksheet tiny = Worksheet::scan(tiny_text.data(), tiny_text.size());
+    Worksheet large = Worksheet::scan(large_text.data(), large_text.size());
+    double value_count = static_cast<double>(large.total_problem_count() * large.values_per_problem());
+    SolveTotal total;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    VK_TRY(this->solve_worksheet(large, Backend::NATIVE, this->moduli_for(large), total));
+    Milliseconds native_time = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    if (!this->vulkan_ready && this->init_vulkan() != VK_SUCCESS) {
+        std::cerr << "vulkan is unavailable, the auto backend will always solve on the host (delete "
+            << this->config.crossover_path << " to calibrate again)" << std::endl;
+        crossover = std::numeric_limits<size_t>::max();
+        return VK_SUCCESS;
+    }
+    Milliseconds startup_time = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    VK_TRY(this->solve_worksheet(tiny, Backend::VULKAN, this->moduli_for(tiny), total)); // creates the pipelines
+    Milliseconds cold_latency = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    VK_TRY(this->solve_worksheet(tiny, Backend::VULKAN, this->moduli_for(tiny), total));
+    Milliseconds warm_latency = std::chrono::steady_clock::now() - begin;
+
+    begin = std::chrono::steady_clock::now();
+    VK_TRY(this->solve_worksheet(large, Backend::VULKAN, this->moduli_for(large), total));
+    Milliseconds vulkan_time = std::chrono::steady_clock::now() - begin;
+
+    double native_cost = native_time.count() / value_count; // milliseconds per value
+    double vulkan_cost = std::max(vulkan_time.count() - warm_latency.count(), 0.0) / value_count;
+    double fixed_cost = startup_time.count() + cold_latency.count();
+    crossover = native_cost > vulkan_cost
+        ? static_cast<size_t>(fixed_cost / (native_cost - vulkan_cost))
+        : std::numeric_limits<size_t>::max(); // the host is faster at any size
+
+    std::cerr << "calibrated the auto backend: host " << native_cost * 1e6 << " ns per value, vulkan " << vulkan_cost * 1e6
+        << " ns per value after " << fixed_cost << " ms to start, crossover at " << crossover << " values" << std::endl;
+    return VK_SUCCESS;
+}
+
+// the host parses chunk n+1 into the next slot while the gpu solves chunk n, each chunk leaves one partial sum behind
+VkResult CephalopodEngine::solve_chunked(const Worksheet& worksheet, const std::vector<uint32_t>& moduli, SolveTotal& total) {
+    const EngineConfig& config = this->config;
+    std::chrono::steady_clock::time_point lap_begin = std::chrono::steady_clock::now();
+    size_t values_per_problem = worksheet.values_per_problem();
+
+    // every slot has to fit in the heap's budget at once, past that a worksheet just takes more (smaller) chunks
+    size_t problem_size = values_per_problem * sizeof(uint32_t) + 2 * this->result_size(); // values, result and reduction scratch at most
+    size_t slots_budget = this->buffer_memory_budget() / PIPELINE_DEPTH;
+    size_t budget_problem_count = slots_budget > SLOT_ALIGNMENT ? (slots_budget - SLOT_ALIGNMENT) / problem_size : 0;
+    size_t chunk_problem_count = std::max<size_t>(std::min(config.chunk_problem_count, budget_problem_count), 1);
+    std::vector<WorksheetChunk> chunks = worksheet.split(chunk_problem_count);
+    size_t slot_count = std::min(PIPELINE_DEPTH, chunks.size());
+
+    size_t slot_stride = 0;
+    for (const WorksheetChunk& chunk : chunks) {
+        slot_stride = std::max(slot_stride, ChunkLayout::of(chunk, values_per_problem, config.fused, this->atomic_reduction, config.wide, config.mixed).total_size);
+    }
+    slot_stride = StructBuilder::round_up(slot_stride, SLOT_ALIGNMENT);
+    size_t partials_offset = slot_count * slot_stride;
+    VK_TRY(this->reserve_buffer(partials_offset + this->partials_size(chunks.size() * moduli.size())));
+    size_t overflow_counts_offset = partials_offset + chunks.size() * moduli.size() * this->result_size(); // one per chunk after the partial sums, wide only
+
+    VkPipeline add_pipeline, mul_pipeline, combine_pipeline;
+    VK_TRY(this->get_solve_pipelines(values_per_problem, add_pipeline, mul_pipeline));
+    VK_TRY(this->get_math_pipeline(Opcode::COMBINE_RESULTS, 0, combine_pipeline));
+    this->phase_timings.layout += lap(lap_begin, "layout");
+
+    bool staged = !this->buffer_host_visible;
+    VmaAllocation upload_allocation = staged ? this->staging_allocation : this->buffer_allocation; // laid out exactly like the working buffer
+    void* mapped_buffer;
+    VK_TRY(vmaMapMemory(this->allocator, upload_allocation, &mapped_buffer));
+    DEFER(unmap_buffer, vmaUnmapMemory(this->allocator, upload_allocation));
+    this->phase_timings.fill += lap(lap_begin, "fill");
+
+    WorksheetCursor cursor = worksheet.begin();
+    uint64_t slot_compute_values[PIPELINE_DEPTH] = {}; // when each slot's last chunk is solved, zero has always been reached
+    for (size_t chunk_index = 0; chunk_index < chunks.size(); chunk_index++) {
+        const WorksheetChunk& chunk = chunks[chunk_index];
+        ChunkLayout layout = ChunkLayout::of(chunk, values_per_problem, config.fused, this->atomic_reduction, config.wide, config.mixed);
+        size_t slot = chunk_index % slot_count;
+        size_t slot_offset = slot * slot_stride;
+
+        // the slot's staging memory, working memory and command buffers are free again once its previous chunk is solved
+        VK_TRY(wait_timeline_semaphore(this->device, this->compute_timeline, slot_compute_values[slot], UINT64_MAX));
+        this->phase_timings.submit += lap(lap_begin, "submit");
+
+        uintptr_t slot_memory = reinterpret_cast<uintptr_t>(mapped_buffer) + slot_offset;
+        uint32_t* add_problems = reinterpret_cast<uint32_t*>(slot_memory + layout.add_problems_offset);
+        uint32_t* mul_problems = reinterpret_cast<uint32_t*>(slot_memory + layout.mul_problems_offset);
+        if (config.mixed) {
+            uint32_t* op_mask = reinterpret_cast<uint32_t*>(slot_memory + layout.op_mask_offset);
+            worksheet.fill_problems_in_order(cursor, chunk, add_problems, op_mask, config.problem_layout);
+        } else {
+            worksheet.fill_problems(cursor, chunk, add_problems, mul_problems, config.problem_layout);
+        }
+        VK_TRY(vmaFlushAllocation(this->allocator, upload_allocation, slot_offset, layout.upload_size)); // does nothing for coherent memory
+        this->metrics.uploaded_bytes += layout.upload_size;
+        this->phase_timings.fill += lap(lap_begin, "fill");
+
+        std::vector<VkSemaphore> wait_semaphores;
+        std::vector<uint64_t> wait_values;
+        std::vector<VkPipelineStageFlags> wait_dst_stage_masks;
+        if (staged && layout.upload_size > 0) {
+            uint64_t upload_value;
+            VK_TRY(this->upload(slot, slot_offset, layout.upload_size, upload_value));
+            wait_semaphores.push_back(this->transfer_timeline);
+            wait_values.push_back(upload_value);
+            wait_dst_stage_masks.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        this->phase_timings.submit += lap(lap_begin, "submit");
+
+        VkCommandBuffer command_buffer = this->compute_command_buffers[slot];
+        this->profiler.scope = "chunk " + std::to_string(chunk_index);
+        VK_TRY(begin_command_buffer(command_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr));
+            uint32_t invocations_query = this->profiler.begin_invocations(command_buffer);
+            this->record_solve_chunk(
+                command_buffer,
+                add_pipeline,
+                mul_pipeline,
+                combine_pipeline,
+                chunk,
+                values_per_problem,
+                slot_offset,
+                moduli,
+                partials_offset + chunk_index * this->result_size(),
+                chunks.size() * this->result_size(), // every modulus has a partial sum for each chunk
+                overflow_counts_offset + chunk_index * sizeof(uint32_t)
+            );
+            this->profiler.end_invocations(command_buffer, invocations_query);
+        VK_TRY(vkEndCommandBuffer(command_buffer));
+        this->phase_timings.record += lap(lap_begin, "record");
+
+        slot_compute_values[slot] = ++this->compute_timeline_value;
+        VK_TRY(submit_command_buffer_timeline(
+            this->queues.compute,
+            command_buffer,
+            wait_semaphores, wait_values, wait_dst_stage_masks,
+            {this->compute_timeline}, {slot_compute_values[slot]}
+        ));
+        this->phase_timings.submit += lap(lap_begin, "submit");
+    }
+
+    return this->sum_partials(partials_offset, chunks.size(), moduli, total);
+}
+
+// the gpu tokenizer needs whole rows of text, so this path always solves the worksheet as a single chunk
+VkResult CephalopodEngine::solve_gpu_parse(const Worksheet& worksheet, const std::vector<uint32_t>& moduli, SolveTotal& total) {
+    const EngineConfig& config = this->config;
+    std::chrono::steady_clock::time_point lap_begin = std::chrono::steady_clock::now();
+    size_t add_problem_count = config.mixed ? worksheet.total_problem_count() : worksheet.add_problem_count; // mixed problems are all in the add region
+    size_t total_problem_count = worksheet.total_problem_count();
+    size_t values_per_problem = worksheet.values_per_problem();
+    std::string_view values_text = worksheet.values_text();
+    size_t parse_block_count = (values_text.size() + PARSE_BYTES_PER_WORKGROUP - 1) / PARSE_BYTES_PER_WORKGROUP;
+
+    StructBuilder struct_builder;
+    size_t text_offset = struct_builder.add<uint32_t>((values_text.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+    size_t block_offsets_offset = struct_builder.add<uint32_t>(parse_block_count);
+    size_t row_starts_offset = struct_builder.add<uint32_t>(values_per_problem);
+    bool partition = config.gpu_partition && !config.mixed; // mixed problems stay in file order, there is nothing to partition
+    size_t partition_block_count = (total_problem_count + PARTITION_PROBLEMS_PER_WORKGROUP - 1) / PARTITION_PROBLEMS_PER_WORKGROUP;
+    size_t op_mask_offset = struct_builder.add<uint32_t>(partition ? op_mask_word_count(total_problem_count) : 0);
+    size_t problem_slots_offset = struct_builder.add<uint32_t>(total_problem_count);
+    size_t upload_size = partition ? problem_slots_offset : struct_builder.total_size(); // everything the host writes sits at the front of the buffer
+    size_t product_block_offsets_offset = struct_builder.add<uint32_t>(partition ? partition_block_count : 0);
+    size_t row_token_offsets_offset = struct_builder.add<uint32_t>(values_per_problem);
+    ChunkLayout layout = ChunkLayout::of(worksheet.whole(), values_per_problem, config.fused, this->atomic_reduction, config.wide, config.mixed);
+    size_t problems_offset = struct_builder.add<UInt128>((layout.total_size + sizeof(UInt128) - 1) / sizeof(UInt128)); // wide results need 16 byte alignment
+    if (config.mixed) upload_size = problems_offset + layout.add_problems_offset; // the op mask leads the chunk, right after the text
+    size_t partials_size = this->partials_size(moduli.size()); // one per modulus, the overflow count goes right after them when wide
+    size_t partials_offset = struct_builder.add<UInt128>((partials_size + sizeof(UInt128) - 1) / sizeof(UInt128));
+    size_t overflow_offset = partials_offset + moduli.size() * this->result_size();
+    if (struct_builder.total_size() > this->buffer_capacity && struct_builder.total_size() > this->buffer_memory_budget()) {
+        std::cerr << "worksheet doesn't fit the memory budget as a single chunk, parsing it on the host instead" << std::endl;
+        return this->solve_chunked(worksheet, moduli, total);
+    }
+
+    // the tokenizer indexes text and problems with 32 bits and each of its passes is a single dispatch
+    if (values_text.size() > UINT32_MAX || total_problem_count * values_per_problem > UINT32_MAX
+        || parse_block_count > this->max_workgroup_count || partition_block_count > this->max_workgroup_count
+        || values_per_problem > this->max_workgroup_count) {
+        std::cerr << "worksheet is too large to parse on the gpu, parsing it on the host instead" << std::endl;
+        return this->solve_chunked(worksheet, moduli, total);
+    }
+    VK_TRY(this->reserve_buffer(struct_builder.total_size()));
+
+    VkPipeline add_pipeline, mul_pipeline, combine_pipeline;
+    VK_TRY(this->get_solve_pipelines(values_per_problem, add_pipeline, mul_pipeline));
+    VK_TRY(this->get_math_pipeline(Opcode::COMBINE_RESULTS, 0, combine_pipeline));
+    this->phase_timings.layout += lap(lap_begin, "layout");
+
+    bool staged = !this->buffer_host_visible;
+    VmaAllocation upload_allocation = staged ? this->staging_allocation : this->buffer_allocation; // laid out exactly like the working buffer
+    {
+        void* mapped_buffer;
+        VK_TRY(vmaMapMemory(this->allocator, upload_allocation, &mapped_buffer));
+        DEFER(unmap_buffer, vmaUnmapMemory(this->allocator, upload_allocation));
+
+        // the gpu tokenizes the text itself, the host only copies it in
+        char* text = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(mapped_buffer) + text_offset);
+        std::memcpy(text, values_text.data(), values_text.size());
+        std::memset(text + values_text.size(), 0, struct_builder.round_up(values_text.size(), sizeof(uint32_t)) - values_text.size());
+
+        uint32_t* row_starts = reinterpret_cast<uint32_t*>(reinterpret_cast<uintptr_t>(mapped_buffer) + row_starts_offset);
+        for (size_t row_index = 0; row_index < values_per_problem; row_index++) {
+            row_starts[row_index] = static_cast<uint32_t>(worksheet.rows[row_index].data() - values_text.data());
+        }
+
+        uint32_t* problem_slots = reinterpret_cast<uint32_t*>(reinterpret_cast<uintptr_t>(mapped_buffer) + problem_slots_offset);
+        if (config.mixed) {
+            std::iota(problem_slots, problem_slots + total_problem_count, 0); // file order
+            WorksheetCursor cursor = worksheet.begin();
+            worksheet.fill_op_mask(cursor, worksheet.whole(), reinterpret_cast<uint32_t*>(reinterpret_cast<uintptr_t>(mapped_buffer) + problems_offset + layout.op_mask_offset));
+        } else if (partition) { // the gpu turns the op mask into problem slots, a bit per problem instead of a word
+            WorksheetCursor cursor = worksheet.begin();
+            worksheet.fill_op_mask(cursor, worksheet.whole(), reinterpret_cast<uint32_t*>(reinterpret_cast<uintptr_t>(mapped_buffer) + op_mask_offset));
+        } else {
+            worksheet.fill_problem_slots(problem_slots);
+        }
+
+        VK_TRY(vmaFlushAllocation(this->allocator, upload_allocation, 0, upload_size)); // does nothing for coherent memory
+        this->metrics.uploaded_bytes += upload_size;
+    }
+    this->phase_timings.fill += lap(lap_begin, "fill");
+
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<uint64_t> wait_values;
+    std::vector<VkPipelineStageFlags> wait_dst_stage_masks;
+    if (staged && upload_size > 0) {
+        uint64_t upload_value;
+        VK_TRY(this->upload(0, 0, upload_size, upload_value));
+        wait_semaphores.push_back(this->transfer_timeline);
+        wait_values.push_back(upload_value);
+        wait_dst_stage_masks.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    this->phase_timings.submit += lap(lap_begin, "submit");
+
+    VkCommandBuffer command_buffer = this->compute_command_buffers[0];
+    VK_TRY(begin_command_buffer(command_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr));
+        uint32_t invocations_query = this->profiler.begin_invocations(command_buffer);
+        if (!values_text.empty()) {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->parse_pipeline);
+            record_parse_worksheet_routine(
+                command_buffer,
+                this->parse_pipeline_layout,
+                this->buffer,
+                this->buffer_address,
+                values_text.size(),
+                total_problem_count,
+                add_problem_count,
+                values_per_problem,
+                config.problem_layout,
+                text_offset,
+                block_offsets_offset,
+                problem_slots_offset,
+                problems_offset + layout.add_problems_offset, // the mul problems directly follow the add problems
+                row_starts_offset,
+                row_token_offsets_offset,
+                partition,
+                op_mask_offset,
+                product_block_offsets_offset,
+                this->profiler
+            );
+
+            record_memory_barrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT
+            );
+        }
+
+        this->record_solve_chunk(
+            command_buffer,
+            add_pipeline,
+            mul_pipeline,
+            combine_pipeline,
+            worksheet.whole(),
+            values_per_problem,
+            problems_offset,
+            moduli,
+            partials_offset,
+            this->result_size(),
+            overflow_offset
+        );
+        this->profiler.end_invocations(command_buffer, invocations_query);
+    VK_TRY(vkEndCommandBuffer(command_buffer));
+    this->phase_timings.record += lap(lap_begin, "record");
+
+    VK_TRY(submit_command_buffer_timeline(
+        this->queues.compute,
+        command_buffer,
+        wait_semaphores, wait_values, wait_dst_stage_masks,
+        {this->compute_timeline}, {++this->compute_timeline_value}
+    ));
+    this->phase_timings.submit += lap(lap_begin, "submit");
+
+    return this->sum_partials(partials_offset, 1, moduli, total);
+}
+
+// milliseconds since lap_begin, which moves up to now so consecutive phases can be timed back to back,
+// every lap is also a span of the trace named after its phase
+double lap(std::chrono::steady_clock::time_point& lap_begin, const char* phase) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    trace_span(phase, "phase", lap_begin, now);
+    std::chrono::duration<double, std::milli> elapsed = now - lap_begin;
+    lap_begin = now;
+    return elapsed.count();
+}
+
+void write_metrics_json(const SolveMetrics& metrics, std::ostream& output) {
+    double solve_seconds = metrics.solve_ms / 1000.0;
+    auto per_second = [&](double count) { return solve_seconds > 0.0 ? count / solve_seconds : 0.0; };
+    const PhaseTimings& phases = metrics.phases;
+    output << "{\n"
+        << "  \"backend\": " << JsonString{metrics.backend == Backend::NATIVE ? "native" : "vulkan"} << ",\n"
+        << "  \"problems\": " << metrics.problem_count << ",\n"
+        << "  \"values\": " << metrics.value_count << ",\n"
+        << "  \"text_bytes\": " << metrics.text_bytes << ",\n"
+        << "  \"uploaded_bytes\": " << metrics.uploaded_bytes << ",\n"
+        << "  \"solve_ms\": " << metrics.solve_ms << ",\n"
+        << "  \"problems_per_second\": " << per_second(static_cast<double>(metrics.problem_count)) << ",\n"
+        << "  \"gigabytes_per_second\": " << per_second(static_cast<double>(metrics.text_bytes)) / 1e9 << ",\n"
+        << "  \"phases_ms\": {\"parse\": " << phases.parse << ", \"layout\": " << phases.layout << ", \"fill\": " << phases.fill
+        << ", \"record\": " << phases.record << ", \"submit\": " << phases.submit << ", \"readback\": " << phases.readback << "},\n";
+
+    output << "  \"kernels\": {";
+    for (uint32_t kind = 0; kind < 3; kind++) {
+        output << (kind > 0 ? ", " : "") << JsonString{dispatch_kind_name(static_cast<DispatchKind>(kind))} << ": ";
+        const std::optional<KernelMetrics>& kernel = metrics.kernels[kind];
+        if (!kernel.has_value()) {
+            output << "null";
+            continue;
+        }
+        double gigabytes_per_second = kernel->ms > 0.0 ? static_cast<double>(kernel->byte_count) / (kernel->ms * 1e6) : 0.0;
+        output << "{\"dispatches\": " << kernel->dispatch_count << ", \"ms\": " << kernel->ms
+            << ", \"bytes\": " << kernel->byte_count << ", \"gigabytes_per_second\": " << gigabytes_per_second << "}";
+    }
+    output << "},\n";
+
+    output << "  \"compute_shader_invocations\": ";
+    if (metrics.compute_invocation_count.has_value()) output << *metrics.compute_invocation_count;
+    else output << "null";
+    output << ",\n  \"memory\": ";
+    if (metrics.memory.has_value()) {
+        output << "{\"blocks\": " << metrics.memory->blockCount << ", \"block_bytes\": " << metrics.memory->blockBytes
+            << ", \"allocations\": " << metrics.memory->allocationCount << ", \"allocation_bytes\": " << metrics.memory->allocationBytes << "}";
+    } else {
+        output << "null";
+    }
+    output << "\n}" << std::endl;
+}
+
+// a single decimal number of values, anything else counts as missing so the engine calibrates again
+bool load_crossover(const std::string& path, size_t& crossover) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> crossover);
+}
+
+void save_crossover(const std::string& path, size_t crossover) {
+    std::ofstream file(path);
+    file << crossover << std::endl;
+    if (!file) std::cout << "failed to save the backend crossover to " << path << std::endl;
+}
+
+uint32_t calculate_gpu_score(VkPhysicalDevice gpu) {
+    VkPhysicalDeviceProperties2 properties;
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = nullptr;
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    VkPhysicalDeviceFeatures2 features;
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceBufferDeviceAddressFeatures bda_features;
+    bda_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features;
+    timeline_semaphore_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    features.pNext = &bda_features;
+    bda_features.pNext = &timeline_semaphore_features;
+    timeline_semaphore_features.pNext = nullptr;
+    vkGetPhysicalDeviceFeatures2(gpu, &features);
+
+    if (
+        properties.properties.limits.maxComputeWorkGroupSize[0] < WORKGROUP_SIZE ||
+        properties.properties.limits.maxComputeSharedMemorySize < WORKGROUP_SIZE * sizeof(uint64_t) ||
+        features.features.shaderInt64 == VK_FALSE ||
+        bda_features.bufferDeviceAddress == VK_FALSE ||
+        timeline_semaphore_features.timelineSemaphore == VK_FALSE
+    ) { // required features
+        return 0;
+    }
+
+    switch (properties.properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 1000; // prefer discrete gpu
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 100; // integrated gpu might be ok
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1; // software implementation, last resort and only if the config allows it
+    }
+
+    return 0;
+}
+
+bool supports_atomic_reduction(VkPhysicalDevice gpu) {
+    VkPhysicalDeviceSubgroupProperties subgroup_properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDeviceProperties2 properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &subgroup_properties
+    };
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    // subgroupAdd on the 64-bit partial sums
+    VkPhysicalDeviceShaderSubgroupExtendedTypesFeatures subgroup_extended_types_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_SUBGROUP_EXTENDED_TYPES_FEATURES,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDeviceShaderAtomicInt64Features atomic_int64_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES,
+        .pNext = &subgroup_extended_types_features
+    };
+
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &atomic_int64_features
+    };
+    vkGetPhysicalDeviceFeatures2(gpu, &features);
+
+    const VkSubgroupFeatureFlags required_operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    return (
+        (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+        (subgroup_properties.supportedOperations & required_operations) == required_operations &&
+        atomic_int64_features.shaderBufferInt64Atomics == VK_TRUE &&
+        subgroup_extended_types_features.shaderSubgroupExtendedTypes == VK_TRUE
+    );
+}
+
+QueueFamilyIndices QueueFamilyIndices::find(VkPhysicalDevice gpu) {
+    uint32_t property_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties2(gpu, &property_count, nullptr);
+    std::vector<VkQueueFamilyProperties2> properties(property_count, VkQueueFamilyProperties2{
+        .sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_PROPERTIES_2,
+        .pNext = nullptr
+    });
+    vkGetPhysicalDeviceQueueFamilyProperties2(gpu, &property_count, properties.data());
+
+    QueueFamilyIndices queue_family_indices{};
+    for (uint32_t index = 0; index < property_count; index++) {
+        const VkQueueFamilyProperties& property = properties[index].queueFamilyProperties;
+        if (!queue_family_indices.compute.has_value() && (property.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            queue_family_indices.compute = index;
+            queue_family_indices.compute_timestamp_valid_bits = property.timestampValidBits;
+        }
+
+        if (
+            !queue_family_indices.transfer.has_value() &&
+            (property.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(property.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+        ) { // a transfer only family is usually backed by a copy engine that runs alongside the compute units
+            queue_family_indices.transfer = index;
+        }
+    }
+
+    return queue_family_indices;
+}
+
+bool QueueFamilyIndices::is_complete() const {
+    return this->compute.has_value();
+}
+
+uint32_t QueueFamilyIndices::transfer_or_compute() const {
+    return this->transfer.value_or(this->compute.value()); // compute queues always support transfers
+}
+
+std::vector<VkDeviceQueueCreateInfo> QueueFamilyIndices::make_queue_create_infos() const {
+    std::vector<VkDeviceQueueCreateInfo> create_infos;
+    create_infos.emplace_back(
+        /* sType = */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        /* pNext = */ nullptr,
+        /* flags = */ 0,
+        /* queueFamilyIndex = */ this->compute.value(),
+        /* queueCount = */ 1,
+        /* pQueuePriorities = */ &QueueFamilyIndices::DEFAULT_QUEUE_PRIORITY
+    );
+    if (this->transfer.has_value()) {
+        create_infos.emplace_back(
+            /* sType = */ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            /* pNext = */ nullptr,
+            /* flags = */ 0,
+            /* queueFamilyIndex = */ this->transfer.value(),
+            /* queueCount = */ 1,
+            /* pQueuePriorities = */ &QueueFamilyIndices::DEFAULT_QUEUE_PRIORITY
+        );
+    }
+    return create_infos;
+}
+
+Queues QueueFamilyIndices::get_queues(VkDevice device) const {
+    Queues queues;
+    vkGetDeviceQueue(device, this->compute.value(), 0, &queues.compute);
+    vkGetDeviceQueue(device, this->transfer_or_compute(), 0, &queues.transfer);
+    return queues;
+}
+
+void record_parse_worksheet_routine(
+    VkCommandBuffer command_buffer,
+    VkPipelineLayout pipeline_layout,
+    VkBuffer buffer,
+    VkDeviceAddress buffer_address,
+    size_t text_size,
+    size_t problem_count,
+    size_t add_problem_count,
+    size_t values_per_problem,
+    ProblemLayout problem_layout,
+    size_t text_offset,
+    size_t block_offsets_offset,
+    size_t problem_slots_offset,
+    size_t problems_offset,
+    size_t row_starts_offset,
+    size_t row_token_offsets_offset,
+    bool partition, // fills the problem slots from the op mask first
+    size_t op_mask_offset,
+    size_t product_block_offsets_offset,
+    DispatchProfiler& profiler
+) {
+    ParsePushConstants push_constants{
+        .text_ptr = buffer_address + text_offset,
+        .block_offsets_ptr = buffer_address + block_offsets_offset,
+        .problem_slots_ptr = buffer_address + problem_slots_offset,
+        .problems_ptr = buffer_address + problems_offset,
+        .text_size = static_cast<uint32_t>(text_size),
+        .problem_count = static_cast<uint32_t>(problem_count),
+        .add_problem_count = static_cast<uint32_t>(add_problem_count),
+        .values_per_problem = static_cast<uint32_t>(values_per_problem),
+        .block_count = static_cast<uint32_t>((text_size + PARSE_BYTES_PER_WORKGROUP - 1) / PARSE_BYTES_PER_WORKGROUP),
+        .problem_layout = problem_layout,
+        .op_mask_ptr = buffer_address + op_mask_offset,
+        .product_block_offsets_ptr = buffer_address + product_block_offsets_offset,
+        .product_block_count = static_cast<uint32_t>((problem_count + PARTITION_PROBLEMS_PER_WORKGROUP - 1) / PARTITION_PROBLEMS_PER_WORKGROUP),
+        .row_starts_ptr = buffer_address + row_starts_offset,
+        .row_token_offsets_ptr = buffer_address + row_token_offsets_offset
+    };
+
+    // values a short row doesn't have read as zero, like on the host, every other value is overwritten by the scatter
+    if (problem_count > 0) vkCmdFillBuffer(command_buffer, buffer, problems_offset, problem_count * values_per_problem * sizeof(uint32_t), 0);
+    record_memory_barrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    // with partition, count the products of each block of the op mask, scan the counts into offsets and turn them into a slot per problem,
+    // then count the tokens starting in each block, scan the counts into offsets, find the first token of every row and parse and scatter every token
+    std::vector<ParseOpcode> passes;
+    if (partition) passes = {ParseOpcode::COUNT_PRODUCTS, ParseOpcode::SCAN_PRODUCT_BLOCKS, ParseOpcode::PARTITION_PROBLEMS};
+    passes.insert(passes.end(), {ParseOpcode::COUNT_TOKENS, ParseOpcode::SCAN_BLOCKS, ParseOpcode::FIND_ROW_TOKENS, ParseOpcode::SCATTER_TOKENS});
+    const char* pass_labels[] = { // indexed by opcode
+        "parse count tokens", "parse scan blocks", "parse scatter tokens",
+        "partition count products", "partition scan blocks", "partition problems",
+        "parse find row tokens"
+    };
+    size_t op_mask_size = op_mask_word_count(problem_count) * sizeof(uint32_t);
+    for (ParseOpcode pass : passes) {
+        if (pass != passes.front()) {
+            record_memory_barrier(
+                command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+            );
+        }
+
+        push_constants.opcode = pass;
+        uint32_t workgroup_count = 1; // the scans
+        size_t byte_count = 0;
+        switch (pass) {
+            case ParseOpcode::COUNT_TOKENS:
+            case ParseOpcode::SCATTER_TOKENS: {
+                workgroup_count = push_constants.block_count;
+                byte_count = text_size;
+                break;
+            }
+
+            case ParseOpcode::SCAN_BLOCKS: {
+                byte_count = push_constants.block_count * sizeof(uint32_t);
+                break;
+            }
+
+            case ParseOpcode::COUNT_PRODUCTS: {
+                workgroup_count = push_constants.product_block_count;
+                byte_count = op_mask_size;
+                break;
+            }
+
+            case ParseOpcode::SCAN_PRODUCT_BLOCKS: {
+                byte_count = push_constants.product_block_count * sizeof(uint32_t);
+                break;
+            }
+
+            case ParseOpcode::FIND_ROW_TOKENS: {
+                workgroup_count = push_constants.values_per_problem; // a block of text per row
+                byte_count = values_per_problem * PARSE_BYTES_PER_WORKGROUP;
+                break;
+            }
+
+            case ParseOpcode::PARTITION_PROBLEMS: {
+                workgroup_count = push_constants.product_block_count;
+                byte_count = op_mask_size + problem_count * sizeof(uint32_t); // reads the mask, writes a slot per problem
+                break;
+            }
+        }
+        uint32_t span = profiler.begin(command_buffer, DispatchKind::PARSE, pass_labels[pass], byte_count);
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+        vkCmdDispatch(command_buffer, workgroup_count, 1, 1);
+        profiler.end(command_buffer, span);
+    }
+}
+
+VkResult create_math_pipeline(
+    VkDevice device,
+    VkPipelineCache pipeline_cache,
+    VkPipelineLayout pipeline_layout,
+    VkShaderModule shader_module,
+    const MathSpecialization& specialization,
+    VkPipeline& pipeline
+) {
+    VkSpecializationMapEntry map_entries[] = {
+        {.constantID = 0, .offset = offsetof(MathSpecialization, workgroup_size), .size = sizeof(uint32_t)},
+        {.constantID = 1, .offset = offsetof(MathSpecialization, opcode), .size = sizeof(uint32_t)},
+        {.constantID = 2, .offset = offsetof(MathSpecialization, values_per_problem), .size = sizeof(uint32_t)},
+        {.constantID = 3, .offset = offsetof(MathSpecialization, arithmetic), .size = sizeof(uint32_t)}
+    };
+
+    VkSpecializationInfo specialization_info{
+        .mapEntryCount = sizeof(map_entries) / sizeof(map_entries[0]),
+        .pMapEntries = map_entries,
+        .dataSize = sizeof(specialization),
+        .pData = &specialization
+    };
+
+    return create_compute_pipeline(device, pipeline_cache, pipeline_layout, shader_module, "main", &specialization_info, pipeline);
+}
+
+// a dispatch can't exceed maxComputeWorkGroupCount[0] workgroups, so larger problem counts are split over several,
+// every piece but the last covers whole workgroups so the next one continues exactly where it left off
+void record_dispatch_problems(
+    VkCommandBuffer command_buffer,
+    VkPipelineLayout pipeline_layout,
+    PushConstants push_constants,
+    size_t problem_count,
+    size_t in_bytes_per_problem,
+    size_t out_bytes_per_workgroup,
+    uint32_t max_workgroup_count
+) {
+    size_t max_piece_problem_count = static_cast<size_t>(max_workgroup_count) * WORKGROUP_SIZE;
+    for (size_t first_problem = 0; first_problem < problem_count; first_problem += max_piece_problem_count) {
+        size_t piece_problem_count = std::min(problem_count - first_problem, max_piece_problem_count);
+        uint32_t workgroup_count = static_cast<uint32_t>((piece_problem_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+        push_constants.problem_count = static_cast<uint32_t>(piece_problem_count);
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+        vkCmdDispatch(command_buffer, workgroup_count, 1, 1);
+
+        push_constants.data_in_ptr += piece_problem_count * in_bytes_per_problem;
+        push_constants.data_out_ptr += workgroup_count * out_bytes_per_workgroup;
+        if (push_constants.op_mask_ptr != 0) push_constants.op_mask_ptr += piece_problem_count / 32 * sizeof(uint32_t); // whole workgroups, so whole words
+    }
+}
+
+void record_solve_math_problems_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkDeviceAddress buffer_address,
+    const ProblemStrides& strides,
+    size_t values_per_problem,
+    size_t problem_count,
+    size_t problems_offset,
+    size_t results_offset,
+    size_t result_size,
+    VkDeviceAddress overflow_address,
+    VkDeviceAddress op_mask_address,
+    const ModularConstants& modular,
+    bool fused,
+    uint32_t max_workgroup_count
+) {
+    PushConstants push_constants{
+        .data_in_ptr = buffer_address + problems_offset,
+        .data_out_ptr = buffer_address + results_offset,
+        .problem_stride = strides.problem_stride * sizeof(uint32_t),
+        .value_stride = strides.value_stride * sizeof(uint32_t),
+        .value_count = static_cast<uint32_t>(values_per_problem),
+        .overflow_ptr = overflow_address,
+        .modulus = modular.modulus,
+        .montgomery_inverse = modular.montgomery_inverse,
+        .montgomery_fixup = modular.montgomery_fixup,
+        .op_mask_ptr = op_mask_address
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    record_dispatch_problems(
+        command_buffer,
+        pipeline_layout,
+        push_constants,
+        problem_count,
+        push_constants.problem_stride,
+        fused ? result_size : WORKGROUP_SIZE * result_size, // one partial sum per workgroup or one result per problem
+        max_workgroup_count
+    );
+}
+
+size_t record_sum_results_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline combine_pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkDeviceAddress buffer_address,
+    size_t result_count,
+    size_t results_offset,
+    size_t scratch_offset,
+    size_t result_size,
+    VkDeviceAddress overflow_address,
+    const ModularConstants& modular,
+    uint32_t max_workgroup_count,
+    DispatchProfiler& profiler
+) {
+    PushConstants push_constants{
+        .data_in_ptr = buffer_address + results_offset,
+        .data_out_ptr = buffer_address + scratch_offset,
+        .overflow_ptr = overflow_address,
+        .modulus = modular.modulus,
+        .montgomery_inverse = modular.montgomery_inverse,
+        .montgomery_fixup = modular.montgomery_fixup
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, combine_pipeline);
+
+    for (size_t level = 0; result_count > 1; level++) {
+        // first, wait for changes to memory made by the previous dispatch to be visible
+        record_memory_barrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+            VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+        );
+
+        std::string label = "reduce level " + std::to_string(level) + " (" + std::to_string(result_count) + " results)";
+        uint32_t span = profiler.begin(command_buffer, DispatchKind::REDUCE, label, result_count * result_size);
+        record_dispatch_problems(command_buffer, pipeline_layout, push_constants, result_count, result_size, result_size, max_workgroup_count);
+        profiler.end(command_buffer, span);
+
+        std::swap(push_constants.data_in_ptr, push_constants.data_out_ptr); // ping pong
+        result_count = (result_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE; // each workgroup reduces a block of results to a single result
+    }
+
+    return push_constants.data_in_ptr - buffer_address; // return offset to final result
+}
+
+size_t record_sum_results_atomic_routine(
+    VkCommandBuffer command_buffer,
+    VkPipeline sum_pipeline,
+    VkPipelineLayout pipeline_layout,
+    VkBuffer buffer,
+    VkDeviceAddress buffer_address,
+    size_t result_count,
+    size_t results_offset,
+    size_t total_offset,
+    uint32_t max_workgroup_count
+) {
+    vkCmdFillBuffer(command_buffer, buffer, total_offset, sizeof(uint64_t), 0); // every workgroup adds its partial sum onto this
+    record_memory_barrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    PushConstants push_constants{
+        .data_in_ptr = buffer_address + results_offset,
+        .data_out_ptr = buffer_address + total_offset
+    };
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, sum_pipeline);
+    record_dispatch_problems(command_buffer, pipeline_layout, push_constants, result_count, sizeof(uint64_t), 0, max_workgroup_count); // every piece adds onto the same total
+
+    return total_offset;
+}
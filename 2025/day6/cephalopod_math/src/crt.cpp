@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <vector>
+#include "wide_integer.hpp"
+#include "crt.hpp"
+
+static uint64_t power_mod(uint64_t base, uint64_t exponent, uint64_t modulus) {
+    uint64_t result = 1 % modulus;
+    base %= modulus;
+    for (; exponent > 0; exponent >>= 1) {
+        if (exponent & 1) result = result * base % modulus; // both below 2^31, the product fits
+        base = base * base % modulus;
+    }
+
+    return result;
+}
+
+// deterministic miller-rabin, the bases 2, 7 and 61 are enough for every 32-bit number
+static bool is_prime(uint32_t number) {
+    if (number < 2) return false;
+    for (uint32_t small_prime : {2u, 3u, 5u, 7u, 61u}) {
+        if (number % small_prime == 0) return number == small_prime;
+    }
+
+    uint32_t odd_part = number - 1;
+    int twos = 0;
+    for (; odd_part % 2 == 0; odd_part /= 2) twos++;
+
+    for (uint32_t base : {2u, 7u, 61u}) {
+        uint64_t x = power_mod(base, odd_part, number);
+        if (x == 1 || x == number - 1) continue;
+
+        bool composite = true;
+        for (int square = 1; square < twos && composite; square++) {
+            x = x * x % number;
+            composite = x != number - 1;
+        }
+        if (composite) return false;
+    }
+
+    return true;
+}
+
+std::vector<uint32_t> crt_moduli(size_t count) {
+    std::vector<uint32_t> moduli;
+    for (uint32_t candidate = (1u << 31) - 1; moduli.size() < count; candidate -= 2) {
+        if (is_prime(candidate)) moduli.push_back(candidate);
+    }
+
+    return moduli;
+}
+
+BigUInt crt_reconstruct(const std::vector<uint64_t>& residues, const std::vector<uint32_t>& moduli) {
+    // garner's algorithm, the value is x = c0 + c1 * m0 + c2 * m0 * m1 + ... with every digit ci below mi
+    std::vector<uint64_t> digits(moduli.size());
+    for (size_t i = 0; i < moduli.size(); i++) {
+        uint64_t modulus = moduli[i];
+        uint64_t prefix = 0; // c0 + c1 * m0 + ... up to digit i - 1, modulo mi
+        uint64_t place = 1; // m0 * m1 * ... * m(i - 1), modulo mi
+        for (size_t j = 0; j < i; j++) {
+            prefix = (prefix + digits[j] * place) % modulus;
+            place = place * moduli[j] % modulus;
+        }
+
+        uint64_t difference = (residues[i] % modulus + modulus - prefix) % modulus;
+        digits[i] = difference * power_mod(place, modulus - 2, modulus) % modulus; // fermat inverse, the moduli are prime
+    }
+
+    BigUInt value;
+    for (size_t i = moduli.size(); i-- > 0;) value.multiply_add(moduli[i], static_cast<uint32_t>(digits[i])); // horner from the top digit
+    return value;
+}
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vk_utilities.hpp"
+#include "dispatch_profiler.hpp"
+#include "json_string.hpp"
+
+static const char* const DISPATCH_KIND_NAMES[] = {"parse", "solve", "reduce"};
+
+const char* dispatch_kind_name(DispatchKind kind) {
+    return DISPATCH_KIND_NAMES[kind];
+}
+
+void DispatchProfiler::destroy() {
+    if (this->device != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(this->device, this->statistics_query_pool, nullptr);
+        vkDestroyQueryPool(this->device, this->query_pool, nullptr);
+    }
+    this->statistics_query_pool = VK_NULL_HANDLE;
+    this->query_pool = VK_NULL_HANDLE;
+}
+
+VkResult DispatchProfiler::init(
+    VkDevice device,
+    float timestamp_period,
+    uint32_t timestamp_valid_bits,
+    uint32_t span_capacity,
+    PFN_vkGetCalibratedTimestampsKHR get_calibrated_timestamps,
+    VkTimeDomainKHR host_time_domain,
+    bool count_invocations
+) {
+    // set first so destroy() cleans up after a query pool that was created before a later failure
+    this->device = device;
+    this->span_capacity = span_capacity;
+    if (timestamp_valid_bits == 0) { // profiling is a diagnostic, the solve goes ahead without it (a trace just has no gpu spans)
+        std::cerr << "warning: the compute queue doesn't support timestamps, dispatches won't be profiled" << std::endl;
+        return VK_SUCCESS;
+    }
+
+    VkQueryPoolCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * span_capacity,
+        .pipelineStatistics = 0
+    };
+    VK_TRY(vkCreateQueryPool(device, &create_info, nullptr, &this->query_pool));
+
+    if (count_invocations) {
+        VkQueryPoolCreateInfo statistics_create_info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = span_capacity, // a command buffer holds at least one span
+            .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+        };
+        VK_TRY(vkCreateQueryPool(device, &statistics_create_info, nullptr, &this->statistics_query_pool));
+    }
+
+    this->nanoseconds_per_tick = timestamp_period;
+    this->tick_mask = timestamp_valid_bits >= 64 ? UINT64_MAX : (uint64_t(1) << timestamp_valid_bits) - 1;
+    this->get_calibrated_timestamps = get_calibrated_timestamps;
+    this->host_time_domain = host_time_domain;
+    return VK_SUCCESS;
+}
+
+bool DispatchProfiler::enabled() const {
+    return this->query_pool != VK_NULL_HANDLE;
+}
+
+void DispatchProfiler::reset() {
+    if (!this->enabled()) return;
+    vkResetQueryPool(this->device, this->query_pool, 0, 2 * this->span_capacity);
+    if (this->statistics_query_pool != VK_NULL_HANDLE) vkResetQueryPool(this->device, this->statistics_query_pool, 0, this->span_capacity);
+    this->labels.clear();
+    this->kinds.clear();
+    this->byte_counts.clear();
+    this->statistics_query_count = 0;
+    this->dropped_span_count = 0;
+}
+
+uint32_t DispatchProfiler::begin(VkCommandBuffer command_buffer, DispatchKind kind, const std::string& label, uint64_t byte_count) {
+    if (!this->enabled()) return NO_SPAN;
+    if (this->labels.size() == this->span_capacity) {
+        this->dropped_span_count++;
+        return NO_SPAN;
+    }
+
+    uint32_t span = static_cast<uint32_t>(this->labels.size());
+    this->labels.push_back(this->scope.empty() ? label : this->scope + " " + label);
+    this->kinds.push_back(kind);
+    this->byte_counts.push_back(byte_count);
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, this->query_pool, 2 * span);
+    return span;
+}
+
+void DispatchProfiler::end(VkCommandBuffer command_buffer, uint32_t span) {
+    if (span == NO_SPAN) return;
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, this->query_pool, 2 * span + 1);
+}
+
+uint32_t DispatchProfiler::begin_invocations(VkCommandBuffer command_buffer) {
+    if (this->statistics_query_pool == VK_NULL_HANDLE || this->statistics_query_count == this->span_capacity) return NO_SPAN;
+    uint32_t query = this->statistics_query_count++;
+    vkCmdBeginQuery(command_buffer, this->statistics_query_pool, query, 0);
+    return query;
+}
+
+void DispatchProfiler::end_invocations(VkCommandBuffer command_buffer, uint32_t query) {
+    if (query == NO_SPAN) return;
+    vkCmdEndQuery(command_buffer, this->statistics_query_pool, query);
+}
+
+std::chrono::steady_clock::time_point DispatchProfiler::host_origin(uint64_t origin_tick, uint64_t last_end_tick) const {
+    auto ticks_to_duration = [&](uint64_t ticks) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::nano>(static_cast<double>(ticks & this->tick_mask) * this->nanoseconds_per_tick)
+        );
+    };
+
+    if (this->get_calibrated_timestamps != nullptr) {
+        VkCalibratedTimestampInfoKHR infos[2] = {
+            {.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_KHR, .pNext = nullptr, .timeDomain = VK_TIME_DOMAIN_DEVICE_KHR},
+            {.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_KHR, .pNext = nullptr, .timeDomain = this->host_time_domain}
+        };
+        uint64_t timestamps[2];
+        uint64_t max_deviation; // nanoseconds, far below a dispatch
+        if (this->get_calibrated_timestamps(this->device, 2, infos, timestamps, &max_deviation) == VK_SUCCESS) {
+            std::chrono::steady_clock::time_point host_now{std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(timestamps[1]))};
+            return host_now - ticks_to_duration(timestamps[0] - origin_tick);
+        }
+    }
+
+    // the solve only returns once the partial sums are back, so this places the spans a little too late
+    return std::chrono::steady_clock::now() - ticks_to_duration(last_end_tick - origin_tick);
+}
+
+VkResult DispatchProfiler::collect(std::vector<DispatchTiming>& timings, std::chrono::steady_clock::time_point& origin) {
+    timings.clear();
+    if (!this->enabled() || this->labels.empty()) return VK_SUCCESS;
+
+    uint32_t query_count = static_cast<uint32_t>(2 * this->labels.size());
+    std::vector<uint64_t> ticks(query_count);
+    VK_TRY(vkGetQueryPoolResults(
+        this->device,
+        this->query_pool,
+        0, query_count,
+        ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+    ));
+
+    // masked differences stay correct even if the counter wrapped during the solve
+    uint64_t origin_tick = ticks[0] & this->tick_mask;
+    uint64_t previous_end = origin_tick;
+    auto to_ms = [&](uint64_t from, uint64_t to) { return static_cast<double>((to - from) & this->tick_mask) * this->nanoseconds_per_tick / 1e6; };
+    for (size_t span = 0; span < this->labels.size(); span++) {
+        uint64_t begin = ticks[2 * span] & this->tick_mask;
+        uint64_t end = ticks[2 * span + 1] & this->tick_mask;
+        timings.push_back({
+            .label = this->labels[span],
+            .kind = this->kinds[span],
+            .start_ms = to_ms(origin_tick, begin),
+            .duration_ms = to_ms(begin, end),
+            .gap_ms = span == 0 ? 0.0 : to_ms(previous_end, begin),
+            .byte_count = this->byte_counts[span]
+        });
+        previous_end = end;
+    }
+    origin = this->host_origin(origin_tick, previous_end);
+
+    if (this->dropped_span_count > 0) {
+        std::cout << "warning: " << this->dropped_span_count << " dispatch spans didn't fit the " << this->span_capacity << " timestamp pairs" << std::endl;
+    }
+    return VK_SUCCESS;
+}
+
+VkResult DispatchProfiler::collect_invocations(std::optional<uint64_t>& invocation_count) {
+    invocation_count.reset();
+    if (this->statistics_query_pool == VK_NULL_HANDLE) return VK_SUCCESS;
+
+    std::vector<uint64_t> counts(this->statistics_query_count); // a single statistic per query
+    if (!counts.empty()) {
+        VK_TRY(vkGetQueryPoolResults(
+            this->device,
+            this->statistics_query_pool,
+            0, this->statistics_query_count,
+            counts.size() * sizeof(uint64_t), counts.data(), sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+        ));
+    }
+
+    invocation_count = 0;
+    for (uint64_t count : counts) *invocation_count += count;
+    return VK_SUCCESS;
+}
+
+double DispatchTiming::gigabytes_per_second() const {
+    return this->duration_ms > 0.0 ? static_cast<double>(this->byte_count) / (this->duration_ms * 1e6) : 0.0;
+}
+
+void print_dispatch_timings(const std::vector<DispatchTiming>& timings, std::ostream& output) {
+    double kind_totals[3] = {};
+    double gap_total = 0.0;
+    output << std::left << std::setw(40) << "dispatch" << std::right << std::setw(12) << "start ms" << std::setw(12) << "ms"
+        << std::setw(12) << "gap ms" << std::setw(12) << "GB/s" << std::endl;
+    for (const DispatchTiming& timing : timings) {
+        output << std::left << std::setw(40) << timing.label << std::right << std::fixed << std::setprecision(4)
+            << std::setw(12) << timing.start_ms << std::setw(12) << timing.duration_ms << std::setw(12) << timing.gap_ms
+            << std::setw(12) << timing.gigabytes_per_second() << std::endl;
+        kind_totals[timing.kind] += timing.duration_ms;
+        gap_total += timing.gap_ms;
+    }
+
+    for (uint32_t kind = 0; kind < 3; kind++) output << DISPATCH_KIND_NAMES[kind] << ": " << kind_totals[kind] << " ms, ";
+    output << "gaps: " << gap_total << " ms" << std::endl;
+}
+
+void write_dispatch_timings_json(const std::vector<DispatchTiming>& timings, std::ostream& output) {
+    output << "[\n";
+    for (size_t index = 0; index < timings.size(); index++) {
+        const DispatchTiming& timing = timings[index];
+        output << "  {\"label\": " << JsonString{timing.label} << ", \"kind\": " << JsonString{DISPATCH_KIND_NAMES[timing.kind]}
+            << ", \"start_ms\": " << timing.start_ms << ", \"duration_ms\": " << timing.duration_ms << ", \"gap_ms\": " << timing.gap_ms << ", \"bytes\": " << timing.byte_count << "}"
+            << (index + 1 < timings.size() ? ",\n" : "\n");
+    }
+    output << "]" << std::endl;
+}
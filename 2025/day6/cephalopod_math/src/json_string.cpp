@@ -0,0 +1,24 @@
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include "json_string.hpp"
+
+std::ostream& operator<<(std::ostream& output, JsonString string) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    output << '"';
+    for (char character : string.text) {
+        switch (character) {
+            case '"': output << "\\\""; break;
+            case '\\': output << "\\\\"; break;
+            case '\n': output << "\\n"; break;
+            case '\r': output << "\\r"; break;
+            case '\t': output << "\\t"; break;
+            default: {
+                uint8_t byte = static_cast<uint8_t>(character);
+                if (byte < 0x20) output << "\\u00" << HEX_DIGITS[byte >> 4] << HEX_DIGITS[byte & 0xF];
+                else output << character; // utf-8 passes through as is
+            }
+        }
+    }
+    return output << '"';
+}
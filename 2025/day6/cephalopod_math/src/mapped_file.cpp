@@ -0,0 +1,106 @@
+#include <cstddef>
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : bytes(nullptr), length(0) {
+#ifdef _WIN32
+    this->file_handle = INVALID_HANDLE_VALUE;
+    this->mapping_handle = nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+    this->close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path) {
+    this->close();
+
+    this->file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (this->file_handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(this->file_handle, &file_size)) {
+        this->close();
+        return false;
+    }
+
+    this->length = static_cast<size_t>(file_size.QuadPart);
+    if (this->length == 0) return true; // can't map an empty file, but it is still a valid (empty) input
+
+    this->mapping_handle = CreateFileMappingA(this->file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (this->mapping_handle == nullptr) {
+        this->close();
+        return false;
+    }
+
+    this->bytes = static_cast<const char*>(MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (this->bytes == nullptr) {
+        this->close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->bytes != nullptr) UnmapViewOfFile(this->bytes);
+    if (this->mapping_handle != nullptr) CloseHandle(this->mapping_handle);
+    if (this->file_handle != INVALID_HANDLE_VALUE) CloseHandle(this->file_handle);
+    this->bytes = nullptr;
+    this->length = 0;
+    this->mapping_handle = nullptr;
+    this->file_handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char* path) {
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    this->length = static_cast<size_t>(file_stat.st_size);
+    if (this->length == 0) { // can't map an empty file, but it is still a valid (empty) input
+        ::close(fd);
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) {
+        this->length = 0;
+        return false;
+    }
+
+    madvise(mapping, this->length, MADV_SEQUENTIAL); // only a hint, we read front to back
+    this->bytes = static_cast<const char*>(mapping);
+    return true;
+}
+
+void MappedFile::close() {
+    if (this->bytes != nullptr) munmap(const_cast<char*>(this->bytes), this->length);
+    this->bytes = nullptr;
+    this->length = 0;
+}
+
+#endif
@@ -0,0 +1,226 @@
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "native_solver.hpp"
+#include "number_parser.hpp"
+#include "wide_integer.hpp"
+
+#ifdef NUMBER_PARSER_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #define TARGET_AVX2
+    #else
+        #define TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+// problems a single task solves, small enough to balance the threads and large enough that handing tasks out is free
+static const size_t TASK_PROBLEM_COUNT = 1 << 14;
+
+// the wrapping kernels multiply this many problems a row at a time, so every row is read sequentially
+static const size_t BLOCK_PROBLEM_COUNT = 256;
+
+// the problems of one operator in value major layout, the i-th values of every problem are contiguous
+struct ProblemRegion {
+    const uint32_t* values;
+    size_t problem_count;
+    size_t values_per_problem;
+
+    const uint32_t* row(size_t index) const { return this->values + index * this->problem_count; }
+};
+
+struct NativeTask {
+    bool is_mul;
+    size_t begin; // problem range within the operator's region
+    size_t end;
+};
+
+// what one task adds to the total, summed in task order once every task is done so the result never depends on scheduling
+struct NativePartial {
+    UInt128 value{};
+    uint64_t overflow_count = 0;
+    std::vector<uint64_t> residues; // one per modulus, narrow only
+};
+
+// sums the problem results of [begin, end) modulo 2^64
+using WrappingKernel = uint64_t (*)(const ProblemRegion& region, size_t begin, size_t end);
+
+static uint64_t sum_add_problems_scalar(const ProblemRegion& region, size_t begin, size_t end) {
+    uint64_t sum = 0; // addition is associative modulo 2^64, so every value can go straight into the total
+    for (size_t index = 0; index < region.values_per_problem; index++) {
+        const uint32_t* row = region.row(index);
+        for (size_t problem = begin; problem < end; problem++) sum += row[problem];
+    }
+
+    return sum;
+}
+
+static uint64_t sum_mul_problems_scalar(const ProblemRegion& region, size_t begin, size_t end) {
+    uint64_t sum = 0;
+    uint64_t products[BLOCK_PROBLEM_COUNT];
+    for (size_t block_begin = begin; block_begin < end; block_begin += BLOCK_PROBLEM_COUNT) {
+        size_t block_size = std::min(BLOCK_PROBLEM_COUNT, end - block_begin);
+        std::fill(products, products + block_size, 1);
+        for (size_t index = 0; index < region.values_per_problem; index++) {
+            const uint32_t* row = region.row(index) + block_begin;
+            for (size_t problem = 0; problem < block_size; problem++) products[problem] *= row[problem];
+        }
+
+        for (size_t problem = 0; problem < block_size; problem++) sum += products[problem];
+    }
+
+    return sum;
+}
+
+#ifdef NUMBER_PARSER_X86
+
+static const size_t AVX2_LANES = 4; // 64-bit lanes per ymm register
+
+// 4 zero extended 32-bit values
+TARGET_AVX2 static inline __m256i load_lanes(const uint32_t* values) {
+    return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+}
+
+// avx2 has no 64-bit multiply, but a 64-bit product times a 32-bit value modulo 2^64 only takes two 32x32 multiplies
+TARGET_AVX2 static inline __m256i multiply_lanes(__m256i products, __m256i values) {
+    __m256i low = _mm256_mul_epu32(products, values);
+    __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(products, 32), values);
+    return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+}
+
+TARGET_AVX2 static inline uint64_t horizontal_sum(__m256i lanes) {
+    alignas(32) uint64_t sums[AVX2_LANES];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sums), lanes);
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+TARGET_AVX2 static uint64_t sum_add_problems_avx2(const ProblemRegion& region, size_t begin, size_t end) {
+    size_t vector_end = begin + (end - begin) / AVX2_LANES * AVX2_LANES;
+    __m256i sums = _mm256_setzero_si256();
+    for (size_t index = 0; index < region.values_per_problem; index++) {
+        const uint32_t* row = region.row(index);
+        for (size_t problem = begin; problem < vector_end; problem += AVX2_LANES) sums = _mm256_add_epi64(sums, load_lanes(row + problem));
+    }
+
+    return horizontal_sum(sums) + sum_add_problems_scalar(region, vector_end, end);
+}
+
+TARGET_AVX2 static uint64_t sum_mul_problems_avx2(const ProblemRegion& region, size_t begin, size_t end) {
+    size_t vector_end = begin + (end - begin) / AVX2_LANES * AVX2_LANES;
+    __m256i sums = _mm256_setzero_si256();
+    __m256i products[BLOCK_PROBLEM_COUNT / AVX2_LANES];
+    for (size_t block_begin = begin; block_begin < vector_end; block_begin += BLOCK_PROBLEM_COUNT) {
+        size_t vector_count = std::min(BLOCK_PROBLEM_COUNT, vector_end - block_begin) / AVX2_LANES;
+        std::fill(products, products + vector_count, _mm256_set1_epi64x(1));
+        for (size_t index = 0; index < region.values_per_problem; index++) {
+            const uint32_t* row = region.row(index) + block_begin;
+            for (size_t vector = 0; vector < vector_count; vector++) {
+                products[vector] = multiply_lanes(products[vector], load_lanes(row + vector * AVX2_LANES));
+            }
+        }
+
+        for (size_t vector = 0; vector < vector_count; vector++) sums = _mm256_add_epi64(sums, products[vector]);
+    }
+
+    return horizontal_sum(sums) + sum_mul_problems_scalar(region, vector_end, end);
+}
+
+#endif
+
+// the residues don't depend on how the sums are grouped, so plain remainders give the same result as the gpu's montgomery form
+static uint64_t sum_problems_modular(const ProblemRegion& region, bool is_mul, uint64_t modulus, size_t begin, size_t end) {
+    uint64_t sum = 0;
+    for (size_t problem = begin; problem < end; problem++) {
+        uint64_t result = is_mul ? 1 : 0;
+        for (size_t index = 0; index < region.values_per_problem; index++) {
+            uint64_t value = region.row(index)[problem] % modulus;
+            result = is_mul ? result * value % modulus : (result + value) % modulus; // both operands are below 2^31
+        }
+
+        sum = (sum + result) % modulus;
+    }
+
+    return sum;
+}
+
+// counts overflows like the shader does, once per problem and once per sum that carries, so the count is zero exactly when the gpu's is
+static void sum_problems_wide(const ProblemRegion& region, bool is_mul, size_t begin, size_t end, NativePartial& partial) {
+    for (size_t problem = begin; problem < end; problem++) {
+        UInt128 result{.low = is_mul ? 1u : 0u, .high = 0};
+        bool overflow = false;
+        for (size_t index = 0; index < region.values_per_problem; index++) {
+            uint32_t value = region.row(index)[problem];
+            overflow = (is_mul ? result.multiply(value) : result.add(UInt128{.low = value, .high = 0})) || overflow;
+        }
+
+        if (overflow) partial.overflow_count++;
+        if (partial.value.add(result)) partial.overflow_count++;
+    }
+}
+
+void solve_native(const Worksheet& worksheet, bool wide, const std::vector<uint32_t>& moduli, WorkerPool& worker_pool, SolveTotal& total) {
+    size_t values_per_problem = worksheet.values_per_problem();
+    std::vector<uint32_t> add_values(worksheet.add_problem_count * values_per_problem);
+    std::vector<uint32_t> mul_values(worksheet.mul_problem_count * values_per_problem);
+    worksheet.fill_problems(add_values.data(), mul_values.data(), ProblemLayout::VALUE_MAJOR);
+
+    ProblemRegion regions[2] = {
+        {.values = add_values.data(), .problem_count = worksheet.add_problem_count, .values_per_problem = values_per_problem},
+        {.values = mul_values.data(), .problem_count = worksheet.mul_problem_count, .values_per_problem = values_per_problem}
+    };
+
+    std::vector<NativeTask> tasks;
+    for (bool is_mul : {false, true}) {
+        size_t problem_count = regions[is_mul].problem_count;
+        for (size_t begin = 0; begin < problem_count; begin += TASK_PROBLEM_COUNT) {
+            tasks.push_back({.is_mul = is_mul, .begin = begin, .end = std::min(begin + TASK_PROBLEM_COUNT, problem_count)});
+        }
+    }
+
+    WrappingKernel add_kernel = sum_add_problems_scalar;
+    WrappingKernel mul_kernel = sum_mul_problems_scalar;
+#ifdef NUMBER_PARSER_X86
+    if (cpu_supports_avx2()) {
+        add_kernel = sum_add_problems_avx2;
+        mul_kernel = sum_mul_problems_avx2;
+    }
+#endif
+
+    std::vector<NativePartial> partials(tasks.size());
+    worker_pool.run(tasks.size(), [&](size_t task_index) {
+        const NativeTask& task = tasks[task_index];
+        const ProblemRegion& region = regions[task.is_mul];
+        NativePartial& partial = partials[task_index];
+        if (wide) {
+            sum_problems_wide(region, task.is_mul, task.begin, task.end, partial);
+            return;
+        }
+
+        for (uint32_t modulus : moduli) {
+            partial.residues.push_back(modulus != 0
+                ? sum_problems_modular(region, task.is_mul, modulus, task.begin, task.end)
+                : (task.is_mul ? mul_kernel : add_kernel)(region, task.begin, task.end)
+            );
+        }
+    });
+
+    total = SolveTotal{};
+    if (wide) {
+        for (const NativePartial& partial : partials) {
+            if (total.value.add(partial.value)) total.overflow_count++;
+            total.overflow_count += partial.overflow_count;
+        }
+
+        return;
+    }
+
+    total.residues.assign(moduli.size(), 0);
+    for (const NativePartial& partial : partials) {
+        for (size_t modulus_index = 0; modulus_index < moduli.size(); modulus_index++) {
+            uint64_t modulus = moduli[modulus_index];
+            uint64_t& residue = total.residues[modulus_index];
+            residue = modulus != 0 ? (residue + partial.residues[modulus_index]) % modulus : residue + partial.residues[modulus_index];
+        }
+    }
+    total.value.low = total.residues[0];
+}
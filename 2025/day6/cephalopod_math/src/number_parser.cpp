@@ -0,0 +1,187 @@
+#include <cstdint>
+#include <array>
+#include <bit>
+#include "number_parser.hpp"
+
+#ifdef NUMBER_PARSER_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define TARGET_SSE41
+        #define TARGET_AVX2
+    #else
+        #define TARGET_SSE41 __attribute__((target("sse4.1")))
+        #define TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#endif
+
+static inline bool is_digit(char c) {
+    return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+static inline uint32_t parse_number(const char*& cursor, const char* end) {
+    uint32_t value = 0;
+    while (cursor != end && is_digit(*cursor)) {
+        value = value * 10 + static_cast<uint32_t>(*(cursor++) - '0');
+    }
+
+    return value;
+}
+
+size_t parse_numbers_scalar(const char*& cursor, const char* end, uint32_t* values, size_t capacity) {
+    size_t count = 0;
+    while (count < capacity) {
+        while (cursor != end && !is_digit(*cursor)) cursor++; // skip padding
+        if (cursor == end) break;
+        values[count++] = parse_number(cursor, end);
+    }
+
+    return count;
+}
+
+#ifdef NUMBER_PARSER_X86
+
+// the simd kernels only ever load within [cursor, end), so they stop this many bytes short and let the scalar loop finish
+static const size_t NUMBER_LOAD_SIZE = 16;
+static const size_t MAX_SIMD_DIGITS = 8;
+
+// for a number of n digits, moves its digits to bytes 8-n..7 and zeroes everything else, so every number looks 8 digits long
+static constexpr std::array<std::array<uint8_t, 16>, MAX_SIMD_DIGITS + 1> make_right_align_shuffles() {
+    std::array<std::array<uint8_t, 16>, MAX_SIMD_DIGITS + 1> shuffles{};
+    for (size_t digit_count = 0; digit_count <= MAX_SIMD_DIGITS; digit_count++) {
+        size_t padding = MAX_SIMD_DIGITS - digit_count;
+        for (size_t index = 0; index < 16; index++) {
+            shuffles[digit_count][index] = index >= padding && index < MAX_SIMD_DIGITS
+                ? static_cast<uint8_t>(index - padding)
+                : 0x80; // high bit set makes pshufb write zero
+        }
+    }
+
+    return shuffles;
+}
+
+alignas(16) static constexpr std::array<std::array<uint8_t, 16>, MAX_SIMD_DIGITS + 1> RIGHT_ALIGN_SHUFFLES = make_right_align_shuffles();
+
+TARGET_SSE41 static inline __m128i digit_values_sse41(__m128i chars) {
+    return _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+}
+
+TARGET_SSE41 static inline uint32_t digit_mask_sse41(__m128i digits) {
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits); // unsigned digit <= 9
+    return static_cast<uint32_t>(_mm_movemask_epi8(is_digit));
+}
+
+// converts the number starting at digits, which must have 16 readable bytes, and leaves number_end just past it
+TARGET_SSE41 static inline uint32_t convert_number_sse41(const char* digits, const char*& number_end, const char* end) {
+    __m128i values = digit_values_sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digits)));
+    uint32_t digit_count = static_cast<uint32_t>(std::countr_zero(~digit_mask_sse41(values)));
+    if (digit_count > MAX_SIMD_DIGITS) { // rare and would not fit the 8 digit lanes anyway
+        number_end = digits;
+        return parse_number(number_end, end);
+    }
+
+    number_end = digits + digit_count;
+    __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(RIGHT_ALIGN_SHUFFLES[digit_count].data()));
+    __m128i aligned = _mm_shuffle_epi8(values, shuffle);
+    __m128i pairs = _mm_maddubs_epi16(aligned, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+    __m128i packed = _mm_packus_epi32(quads, quads);
+    __m128i octets = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(octets));
+}
+
+// converts every number starting in a block, starts has one bit per byte of the block where a digit run begins
+TARGET_SSE41 static inline bool convert_block_sse41(
+    const char* block,
+    uint32_t starts,
+    const char*& cursor,
+    const char* end,
+    uint32_t* values,
+    size_t& count,
+    size_t capacity
+) {
+    while (starts != 0) {
+        if (count == capacity) return false;
+        values[count++] = convert_number_sse41(block + std::countr_zero(starts), cursor, end);
+        starts &= starts - 1;
+    }
+
+    return true;
+}
+
+TARGET_SSE41 size_t parse_numbers_sse41(const char*& cursor, const char* end, uint32_t* values, size_t capacity) {
+    const size_t BLOCK_SIZE = 16;
+    size_t count = 0;
+    const char* block = cursor;
+    uint32_t previous_is_digit = 0; // the cursor always sits just past a number, never inside one
+
+    while (static_cast<size_t>(end - block) >= BLOCK_SIZE + NUMBER_LOAD_SIZE) {
+        uint32_t mask = digit_mask_sse41(digit_values_sse41(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block))));
+        uint32_t starts = mask & ~((mask << 1) | previous_is_digit);
+        previous_is_digit = mask >> (BLOCK_SIZE - 1);
+
+        if (!convert_block_sse41(block, starts, cursor, end, values, count, capacity)) return count;
+        block += BLOCK_SIZE;
+    }
+
+    if (cursor < block) cursor = block; // skip the padding already scanned, a number spilling over the last block was already parsed
+    return count + parse_numbers_scalar(cursor, end, values + count, capacity - count);
+}
+
+TARGET_AVX2 size_t parse_numbers_avx2(const char*& cursor, const char* end, uint32_t* values, size_t capacity) {
+    const size_t BLOCK_SIZE = 32;
+    size_t count = 0;
+    const char* block = cursor;
+    uint32_t previous_is_digit = 0; // the cursor always sits just past a number, never inside one
+
+    while (static_cast<size_t>(end - block) >= BLOCK_SIZE + NUMBER_LOAD_SIZE) {
+        __m256i digits = _mm256_sub_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)), _mm256_set1_epi8('0'));
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, _mm256_set1_epi8(9)), digits);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(is_digit));
+        uint32_t starts = mask & ~((mask << 1) | previous_is_digit);
+        previous_is_digit = mask >> (BLOCK_SIZE - 1);
+
+        if (!convert_block_sse41(block, starts, cursor, end, values, count, capacity)) return count;
+        block += BLOCK_SIZE;
+    }
+
+    if (cursor < block) cursor = block; // skip the padding already scanned, a number spilling over the last block was already parsed
+    return count + parse_numbers_scalar(cursor, end, values + count, capacity - count);
+}
+
+static bool cpu_supports_sse41() {
+#ifdef _MSC_VER
+    int registers[4];
+    __cpuid(registers, 1);
+    return (registers[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+bool cpu_supports_avx2() {
+#ifdef _MSC_VER
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7) return false;
+
+    __cpuid(registers, 1);
+    bool os_saves_ymm = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6; // OSXSAVE, then xmm and ymm state enabled
+    if (!os_saves_ymm) return false;
+
+    __cpuidex(registers, 7, 0);
+    return (registers[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+NumberParser select_number_parser() {
+#ifdef NUMBER_PARSER_X86
+    if (cpu_supports_avx2()) return parse_numbers_avx2;
+    if (cpu_supports_sse41()) return parse_numbers_sse41;
+#endif
+    return parse_numbers_scalar;
+}
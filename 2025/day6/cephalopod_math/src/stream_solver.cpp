@@ -0,0 +1,230 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "stream_solver.hpp"
+#include "number_parser.hpp"
+
+static const size_t READ_BLOCK_SIZE = 1 << 20;
+static const size_t PARSE_BLOCK_SIZE = 256;
+
+// 64-bit offsets even where long is 32 bits
+static int seek_file(std::FILE* file, int64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin);
+#else
+    return fseeko(file, offset, origin);
+#endif
+}
+
+static int64_t tell_file(std::FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+// hands out one line at a time from a file read in large blocks, only ever holds the current line plus one block
+class LineReader {
+private:
+    std::FILE* file;
+    uint64_t remaining_bytes; // stops reading here even if the file goes on
+    std::vector<char> buffer;
+    size_t line_begin;
+    size_t buffer_end;
+
+public:
+    LineReader(std::FILE* file, uint64_t byte_limit) : file(file), remaining_bytes(byte_limit), buffer(READ_BLOCK_SIZE), line_begin(0), buffer_end(0) {}
+
+    // strips the line break (and a preceding \r), returns false once the input is exhausted
+    bool next(std::string_view& line) {
+        size_t search_begin = this->line_begin;
+        while (true) {
+            const char* line_end = static_cast<const char*>(std::memchr(
+                this->buffer.data() + search_begin, '\n', this->buffer_end - search_begin
+            ));
+            bool exhausted = line_end == nullptr && (this->remaining_bytes == 0 || std::feof(this->file) || std::ferror(this->file));
+            if (line_end != nullptr || exhausted) {
+                if (line_end == nullptr) {
+                    if (this->line_begin == this->buffer_end) return false;
+                    line_end = this->buffer.data() + this->buffer_end; // last line without a line break
+                }
+
+                line = std::string_view(this->buffer.data() + this->line_begin, line_end - (this->buffer.data() + this->line_begin));
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                this->line_begin = std::min<size_t>(line_end - this->buffer.data() + 1, this->buffer_end);
+                return true;
+            }
+
+            // the line continues past the buffer, move it to the front and read more behind it
+            size_t line_size = this->buffer_end - this->line_begin;
+            std::memmove(this->buffer.data(), this->buffer.data() + this->line_begin, line_size);
+            this->line_begin = 0;
+            this->buffer_end = line_size;
+            search_begin = line_size;
+            if (this->buffer.size() - this->buffer_end < READ_BLOCK_SIZE) this->buffer.resize(this->buffer_end + READ_BLOCK_SIZE);
+
+            size_t read_size = static_cast<size_t>(std::min<uint64_t>(this->buffer.size() - this->buffer_end, this->remaining_bytes));
+            size_t read_count = std::fread(this->buffer.data() + this->buffer_end, 1, read_size, this->file);
+            this->buffer_end += read_count;
+            this->remaining_bytes -= read_count;
+        }
+    }
+};
+
+// running totals of every problem, updated a row at a time
+struct ColumnTotals {
+    std::vector<uint8_t> is_mul; // one per problem when the operators are known before the rows, otherwise empty
+    std::vector<uint64_t> totals; // the sum or product of each problem, just the sums while the operators are unknown
+    std::vector<uint64_t> products; // only while the operators are unknown
+    size_t row_count = 0;
+
+    static ColumnTotals with_ops(std::string_view ops) {
+        ColumnTotals column_totals;
+        for (char op : ops) {
+            if (op == '+' || op == '*') column_totals.is_mul.push_back(op == '*');
+        }
+        column_totals.totals.resize(column_totals.is_mul.size());
+        for (size_t column = 0; column < column_totals.totals.size(); column++) column_totals.totals[column] = column_totals.is_mul[column];
+        return column_totals;
+    }
+
+    void add_row(std::string_view row) {
+        static const NumberParser parse_numbers = select_number_parser();
+        const char* cursor = row.data();
+        const char* row_end = row.data() + row.size();
+        bool ops_known = !this->is_mul.empty();
+        size_t max_column_count = ops_known ? this->is_mul.size() : SIZE_MAX; // values past the last operator are never used
+
+        size_t column = 0;
+        uint32_t block[PARSE_BLOCK_SIZE];
+        while (column < max_column_count) {
+            size_t block_count = parse_numbers(cursor, row_end, block, std::min(max_column_count - column, PARSE_BLOCK_SIZE));
+            if (block_count == 0) break;
+
+            uint64_t* totals = this->totals.data() + column;
+            if (ops_known) {
+                const uint8_t* is_mul = this->is_mul.data() + column;
+                for (size_t index = 0; index < block_count; index++) {
+                    totals[index] = is_mul[index] ? totals[index] * block[index] : totals[index] + block[index];
+                }
+            } else {
+                if (this->totals.size() < column + block_count) { // columns that earlier rows were too short for held zeroes there
+                    this->totals.resize(column + block_count, 0);
+                    this->products.resize(column + block_count, this->row_count == 0 ? 1 : 0);
+                    totals = this->totals.data() + column;
+                }
+
+                uint64_t* products = this->products.data() + column;
+                for (size_t index = 0; index < block_count; index++) {
+                    totals[index] += block[index];
+                    products[index] *= block[index];
+                }
+            }
+            column += block_count;
+        }
+
+        // short row, missing values read as zero like a failed stream extraction would
+        if (ops_known) {
+            for (; column < this->totals.size(); column++) {
+                if (this->is_mul[column]) this->totals[column] = 0;
+            }
+        } else {
+            std::fill(this->products.begin() + std::min(column, this->products.size()), this->products.end(), 0);
+        }
+        this->row_count++;
+    }
+
+    uint64_t total(std::string_view ops) const {
+        uint64_t total = 0;
+        if (!this->is_mul.empty()) {
+            for (uint64_t column_total : this->totals) total += column_total;
+            return total;
+        }
+
+        size_t column = 0;
+        for (char op : ops) {
+            if (op != '+' && op != '*') continue;
+            if (column < this->totals.size()) total += op == '+' ? this->totals[column] : this->products[column];
+            else if (op == '*' && this->row_count == 0) total += 1; // an empty product, there are no rows at all
+            column++;
+        }
+        return total;
+    }
+};
+
+static bool is_ops_line(std::string_view line) {
+    return line.find_first_of("+*") != std::string_view::npos;
+}
+
+// walks back from the end of the file to the last non-empty line, the problems' operators
+static bool read_ops_line(std::FILE* file, std::string& ops, int64_t& ops_offset) {
+    if (seek_file(file, 0, SEEK_END) != 0) return false;
+    int64_t position = tell_file(file);
+    if (position < 0) return false;
+
+    std::vector<char> block(READ_BLOCK_SIZE);
+    int64_t ops_end = -1;
+    ops_offset = -1;
+    while (position > 0 && ops_offset < 0) {
+        size_t block_size = static_cast<size_t>(std::min<int64_t>(position, READ_BLOCK_SIZE));
+        position -= block_size;
+        if (seek_file(file, position, SEEK_SET) != 0 || std::fread(block.data(), 1, block_size, file) != block_size) return false;
+
+        for (size_t index = block_size; index-- > 0 && ops_offset < 0;) {
+            bool is_line_break = block[index] == '\n' || block[index] == '\r';
+            if (ops_end < 0 && !is_line_break) ops_end = position + index + 1;
+            else if (ops_end >= 0 && block[index] == '\n') ops_offset = position + index + 1;
+        }
+    }
+
+    if (ops_end < 0) ops_end = 0; // nothing but line breaks
+    if (ops_offset < 0) ops_offset = 0; // the ops line is the whole file
+    ops.resize(static_cast<size_t>(ops_end - ops_offset));
+    return seek_file(file, ops_offset, SEEK_SET) == 0 && std::fread(ops.data(), 1, ops.size(), file) == ops.size();
+}
+
+bool solve_streaming(const char* path, uint64_t& result) {
+    ColumnTotals totals;
+    std::string ops;
+
+    if (std::strcmp(path, "-") == 0) { // no seeking back for the ops, every problem tracks both operators until they arrive
+        LineReader reader(stdin, UINT64_MAX);
+        std::string_view line;
+        while (reader.next(line)) {
+            if (line.empty()) continue;
+            if (is_ops_line(line)) {
+                ops = line;
+                break;
+            }
+            totals.add_row(line);
+        }
+
+        if (std::ferror(stdin)) return false;
+    } else {
+        std::FILE* file = std::fopen(path, "rb");
+        if (file == nullptr) return false;
+
+        int64_t ops_offset;
+        bool read = read_ops_line(file, ops, ops_offset) && seek_file(file, 0, SEEK_SET) == 0;
+        if (read) {
+            totals = ColumnTotals::with_ops(ops);
+            LineReader reader(file, static_cast<uint64_t>(ops_offset));
+            std::string_view line;
+            while (reader.next(line)) {
+                if (!line.empty()) totals.add_row(line);
+            }
+            read = !std::ferror(file);
+        }
+
+        std::fclose(file);
+        if (!read) return false;
+    }
+
+    result = totals.total(ops);
+    return true;
+}
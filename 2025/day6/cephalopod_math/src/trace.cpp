@@ -0,0 +1,104 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "trace.hpp"
+#include "json_string.hpp"
+
+// every host thread gets its own track in the host process, the gpu's spans go to a second process so they sit apart
+static const uint32_t HOST_PROCESS_ID = 1;
+static const uint32_t DEVICE_PROCESS_ID = 2;
+
+struct TraceEvent {
+    std::string name;
+    const char* category;
+    uint32_t process_id;
+    uint32_t thread_id;
+    double timestamp_us; // since tracing was enabled
+    double duration_us;
+};
+
+static std::atomic<bool> trace_enabled = false;
+static std::chrono::steady_clock::time_point trace_origin;
+static std::mutex trace_mutex; // guards everything below
+static std::vector<TraceEvent> trace_events;
+static std::map<std::thread::id, uint32_t> trace_thread_ids; // numbered in the order each thread finishes its first span
+
+static double microseconds_since_origin(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration<double, std::micro>(time - trace_origin).count();
+}
+
+void enable_tracing() {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_enabled) return;
+    trace_origin = std::chrono::steady_clock::now();
+    trace_enabled = true;
+}
+
+bool tracing_enabled() {
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_span(const char* name, const char* category, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) {
+    if (!tracing_enabled()) return;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    auto [thread, inserted] = trace_thread_ids.try_emplace(std::this_thread::get_id(), static_cast<uint32_t>(trace_thread_ids.size() + 1));
+    trace_events.push_back({
+        .name = name,
+        .category = category,
+        .process_id = HOST_PROCESS_ID,
+        .thread_id = thread->second,
+        .timestamp_us = microseconds_since_origin(begin),
+        .duration_us = std::chrono::duration<double, std::micro>(end - begin).count()
+    });
+}
+
+void trace_device_span(const std::string& name, const char* category, std::chrono::steady_clock::time_point begin, double duration_ms) {
+    if (!tracing_enabled()) return;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_events.push_back({
+        .name = name,
+        .category = category,
+        .process_id = DEVICE_PROCESS_ID,
+        .thread_id = 1, // the compute queue, the only one with timestamps
+        .timestamp_us = microseconds_since_origin(begin),
+        .duration_us = duration_ms * 1000.0
+    });
+}
+
+bool write_trace(const char* path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    std::ofstream output(path);
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    output << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << HOST_PROCESS_ID << ", \"args\": {\"name\": \"host\"}},\n";
+    output << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << DEVICE_PROCESS_ID << ", \"args\": {\"name\": \"gpu\"}},\n";
+    output << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << DEVICE_PROCESS_ID << ", \"tid\": 1, \"args\": {\"name\": \"compute queue\"}}";
+    output << std::fixed;
+    for (const TraceEvent& event : trace_events) {
+        output << ",\n  {\"name\": " << JsonString{event.name} << ", \"cat\": " << JsonString{event.category} << ", \"ph\": \"X\""
+            << ", \"pid\": " << event.process_id << ", \"tid\": " << event.thread_id
+            << ", \"ts\": " << event.timestamp_us << ", \"dur\": " << event.duration_us << "}";
+    }
+    output << "\n]}" << std::endl;
+
+    if (!output) {
+        std::cout << "failed to write trace " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+TraceScope::TraceScope(const char* name, const char* category) : name(name), category(category) {
+    if (tracing_enabled()) this->begin = std::chrono::steady_clock::now();
+}
+
+TraceScope::~TraceScope() {
+    // a scope entered before tracing was enabled has no begin and is left out
+    if (tracing_enabled() && this->begin != std::chrono::steady_clock::time_point{}) trace_span(this->name, this->category, this->begin, std::chrono::steady_clock::now());
+}
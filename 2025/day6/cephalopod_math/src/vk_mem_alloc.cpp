@@ -0,0 +1,3 @@
+#define VMA_IMPLEMENTATION
+#define VMA_VULKAN_VERSION 1003000 // Vulkan 1.3
+#include "vk_mem_alloc.h"
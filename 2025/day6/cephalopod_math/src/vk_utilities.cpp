@@ -1,9 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 #include "vk_utilities.hpp"
+#include "trace.hpp"
 
 VkResult create_vulkan_instance(
     const char* app_name,
@@ -13,6 +17,7 @@ VkResult create_vulkan_instance(
     const std::vector<const char*>& enabled_extensions,
     VkInstance& instance
 ) {
+    TRACE_SCOPE(trace, "create_vulkan_instance", "startup");
     VkApplicationInfo app_info{
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pNext = nullptr,
@@ -38,6 +43,7 @@ VkResult create_vulkan_instance(
 }
 
 VkPhysicalDevice pick_physical_device(VkInstance instance, uint32_t score_gpu(VkPhysicalDevice gpu)) {
+    TRACE_SCOPE(trace, "pick_physical_device", "startup");
     uint32_t gpu_count = 0;
     vkEnumeratePhysicalDevices(instance, &gpu_count, nullptr); // query number of gpus without allocating
     std::vector<VkPhysicalDevice> gpus(gpu_count);
@@ -56,6 +62,47 @@ VkPhysicalDevice pick_physical_device(VkInstance instance, uint32_t score_gpu(Vk
     return best_gpu;
 }
 
+bool supports_device_extension(VkPhysicalDevice gpu, const char* extension_name) {
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extension_count, extensions.data());
+
+    for (const VkExtensionProperties& extension : extensions) {
+        if (std::strcmp(extension.extensionName, extension_name) == 0) return true;
+    }
+
+    return false;
+}
+
+const char* find_calibrated_timestamps_extension(VkInstance instance, VkPhysicalDevice gpu, VkTimeDomainKHR host_time_domain) {
+    // the khr extension is the ext one promoted, same entry points under a different suffix
+    const char* candidates[][2] = {
+        {VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, "vkGetPhysicalDeviceCalibrateableTimeDomainsKHR"},
+        {VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"}
+    };
+    for (const auto& [extension_name, function_name] : candidates) {
+        if (!supports_device_extension(gpu, extension_name)) continue;
+        auto get_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsKHR>(vkGetInstanceProcAddr(instance, function_name));
+        if (get_time_domains == nullptr) continue;
+
+        uint32_t time_domain_count = 0;
+        get_time_domains(gpu, &time_domain_count, nullptr);
+        std::vector<VkTimeDomainKHR> time_domains(time_domain_count);
+        get_time_domains(gpu, &time_domain_count, time_domains.data());
+
+        bool has_device = false;
+        bool has_host = false;
+        for (VkTimeDomainKHR time_domain : time_domains) {
+            has_device = has_device || time_domain == VK_TIME_DOMAIN_DEVICE_KHR;
+            has_host = has_host || time_domain == host_time_domain;
+        }
+        if (has_device && has_host) return extension_name;
+    }
+
+    return nullptr;
+}
+
 VkResult create_logical_device(
     VkPhysicalDevice gpu,
     const std::vector<VkDeviceQueueCreateInfo>& queue_create_infos,
@@ -63,6 +110,7 @@ VkResult create_logical_device(
     const std::vector<const char*>& enabled_extensions,
     VkDevice& device
 ) {
+    TRACE_SCOPE(trace, "create_logical_device", "startup");
     VkDeviceCreateInfo create_info{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = &enabled_features,
@@ -80,6 +128,7 @@ VkResult create_logical_device(
 }
 
 VkResult create_shader_module_from_file(VkDevice device, const char* path, VkShaderModule& shader_module) {
+    TRACE_SCOPE(trace, "create_shader_module_from_file", "startup");
     std::ifstream file(path, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
         std::cout << "failed to open shader binary " << path << std::endl;
@@ -131,12 +180,14 @@ VkResult create_pipeline_layout(
 
 VkResult create_compute_pipeline(
     VkDevice device,
+    VkPipelineCache pipeline_cache,
     VkPipelineLayout pipeline_layout,
     VkShaderModule shader_module,
     const char* entrypoint,
     const VkSpecializationInfo* specialization_info,
     VkPipeline& pipeline
 ) {
+    TRACE_SCOPE(trace, "create_compute_pipeline", "startup"); // also when an unrolled variant is first needed mid solve
     VkComputePipelineCreateInfo create_info{
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
         .pNext = nullptr,
@@ -155,7 +206,112 @@ VkResult create_compute_pipeline(
         .basePipelineIndex = 0
     };
 
-    return vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline);
+    return vkCreateComputePipelines(device, pipeline_cache, 1, &create_info, nullptr, &pipeline);
+}
+
+// written in front of the driver's own cache data, the driver's header identifies the device but not the driver version
+struct PipelineCacheFileHeader {
+    inline static const uint32_t MAGIC = 0x43504331; // "CPC1"
+    uint32_t magic;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+};
+
+static bool is_pipeline_cache_compatible(const PipelineCacheFileHeader& file_header, const std::vector<char>& data, const VkPhysicalDeviceProperties& gpu_properties) {
+    if (
+        file_header.magic != PipelineCacheFileHeader::MAGIC ||
+        file_header.driver_version != gpu_properties.driverVersion ||
+        std::memcmp(file_header.pipeline_cache_uuid, gpu_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+        data.size() < sizeof(VkPipelineCacheHeaderVersionOne)
+    ) {
+        return false;
+    }
+
+    VkPipelineCacheHeaderVersionOne cache_header;
+    std::memcpy(&cache_header, data.data(), sizeof(cache_header)); // the data has no alignment guarantees
+    return cache_header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne)
+        && cache_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && cache_header.vendorID == gpu_properties.vendorID
+        && cache_header.deviceID == gpu_properties.deviceID
+        && std::memcmp(cache_header.pipelineCacheUUID, gpu_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkResult create_pipeline_cache_from_file(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& gpu_properties,
+    const char* path,
+    VkPipelineCache& pipeline_cache
+) {
+    TRACE_SCOPE(trace, "create_pipeline_cache_from_file", "startup");
+    std::vector<char> data;
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        std::vector<char> contents(file.tellg()); // opened with read pointer at end so tellg() gives the file size in bytes
+        file.seekg(0);
+        file.read(contents.data(), contents.size());
+
+        PipelineCacheFileHeader file_header{};
+        if (contents.size() >= sizeof(file_header)) std::memcpy(&file_header, contents.data(), sizeof(file_header));
+        if (file_header.data_size == contents.size() - sizeof(file_header)) data.assign(contents.begin() + sizeof(file_header), contents.end());
+
+        if (!is_pipeline_cache_compatible(file_header, data, gpu_properties)) {
+            std::cout << "discarding stale pipeline cache " << path << std::endl;
+            data.clear(); // start from an empty cache, it is rewritten on exit
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .initialDataSize = data.size(),
+        .pInitialData = data.data()
+    };
+
+    return vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache);
+}
+
+VkResult save_pipeline_cache_to_file(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& gpu_properties,
+    VkPipelineCache pipeline_cache,
+    const char* path
+) {
+    TRACE_SCOPE(trace, "save_pipeline_cache_to_file", "shutdown");
+    size_t data_size = 0;
+    VkResult result = vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr); // query size without copying
+    if (result != VK_SUCCESS) return result;
+    std::vector<char> data(data_size);
+    result = vkGetPipelineCacheData(device, pipeline_cache, &data_size, data.data());
+    if (result != VK_SUCCESS) return result; // VK_INCOMPLETE would leave a truncated cache, better to write nothing
+
+    PipelineCacheFileHeader file_header{
+        .magic = PipelineCacheFileHeader::MAGIC,
+        .driver_version = gpu_properties.driverVersion,
+        .pipeline_cache_uuid = {},
+        .data_size = data_size
+    };
+    std::memcpy(file_header.pipeline_cache_uuid, gpu_properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // write next to the real file and swap it in so a concurrent run never reads a half written cache
+    std::string temporary_path = std::string(path) + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open() || !file.write(reinterpret_cast<const char*>(&file_header), sizeof(file_header)) || !file.write(data.data(), data_size)) {
+            std::cout << "failed to write pipeline cache " << temporary_path << std::endl;
+            return VK_ERROR_UNKNOWN;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        std::cout << "failed to replace pipeline cache " << path << ": " << error.message() << std::endl;
+        return VK_ERROR_UNKNOWN;
+    }
+
+    return VK_SUCCESS;
 }
 
 VkResult create_command_pool(VkDevice device, VkCommandPoolCreateFlags flags, uint32_t queue_family_index, VkCommandPool& command_pool) {
@@ -196,6 +352,37 @@ VkResult create_fence(VkDevice device, bool create_signalled, VkFence& fence) {
     return vkCreateFence(device, &create_info, nullptr, &fence);
 }
 
+VkResult create_timeline_semaphore(VkDevice device, uint64_t initial_value, VkSemaphore& semaphore) {
+    VkSemaphoreTypeCreateInfo type_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initial_value
+    };
+
+    VkSemaphoreCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+        .flags = 0
+    };
+
+    return vkCreateSemaphore(device, &create_info, nullptr, &semaphore);
+}
+
+VkResult wait_timeline_semaphore(VkDevice device, VkSemaphore semaphore, uint64_t value, uint64_t timeout) {
+    TRACE_SCOPE(trace, "wait_timeline_semaphore", "wait");
+    VkSemaphoreWaitInfo wait_info{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &value
+    };
+
+    return vkWaitSemaphores(device, &wait_info, timeout);
+}
+
 VkResult begin_command_buffer(
     VkCommandBuffer command_buffer,
     VkCommandBufferUsageFlags usage_flags,
@@ -233,3 +420,62 @@ VkResult submit_command_buffer(
 
     return vkQueueSubmit(queue, 1, &submit_info, fence);
 }
+
+VkResult submit_command_buffer_timeline(
+    VkQueue queue,
+    VkCommandBuffer command_buffer,
+    const std::vector<VkSemaphore>& wait_semaphores,
+    const std::vector<uint64_t>& wait_values,
+    const std::vector<VkPipelineStageFlags>& wait_dst_stage_masks,
+    const std::vector<VkSemaphore>& signal_semaphores,
+    const std::vector<uint64_t>& signal_values
+) {
+    TRACE_SCOPE(trace, "submit_command_buffer_timeline", "submit");
+    VkTimelineSemaphoreSubmitInfo timeline_info{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size()),
+        .pWaitSemaphoreValues = wait_values.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size()),
+        .pSignalSemaphoreValues = signal_values.data()
+    };
+
+    VkSubmitInfo submit_info{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
+        .waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size()),
+        .pWaitSemaphores = wait_semaphores.data(),
+        .pWaitDstStageMask = wait_dst_stage_masks.data(),
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+        .signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size()),
+        .pSignalSemaphores = signal_semaphores.data()
+    };
+
+    return vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+}
+
+void record_memory_barrier(
+    VkCommandBuffer command_buffer,
+    VkPipelineStageFlags src_stage_mask,
+    VkPipelineStageFlags dst_stage_mask,
+    VkAccessFlags src_access_mask,
+    VkAccessFlags dst_access_mask
+) {
+    VkMemoryBarrier memory_barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = src_access_mask,
+        .dstAccessMask = dst_access_mask
+    };
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        src_stage_mask,
+        dst_stage_mask,
+        (VkDependencyFlags)0,
+        1, &memory_barrier,
+        0, nullptr,
+        0, nullptr
+    );
+}
@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "wide_integer.hpp"
+
+bool UInt128::add(const UInt128& other) {
+    uint64_t low = this->low + other.low;
+    uint64_t carry = low < this->low ? 1 : 0;
+    uint64_t high = this->high + other.high + carry;
+    bool overflow = high < this->high || (carry != 0 && high == this->high);
+
+    this->low = low;
+    this->high = high;
+    return overflow;
+}
+
+bool UInt128::multiply(uint32_t factor) {
+    // 64 bits at a time, each half times a 32-bit factor plus the carry below it fits in 96 bits
+    uint64_t low_low = (this->low & UINT32_MAX) * factor;
+    uint64_t low_high = (this->low >> 32) * factor + (low_low >> 32);
+    uint64_t high_low = (this->high & UINT32_MAX) * factor + (low_high >> 32);
+    uint64_t high_high = (this->high >> 32) * factor + (high_low >> 32);
+
+    this->low = (low_low & UINT32_MAX) | (low_high << 32);
+    this->high = (high_low & UINT32_MAX) | (high_high << 32);
+    return (high_high >> 32) != 0;
+}
+
+std::string UInt128::to_string() const {
+    BigUInt value;
+    value.limbs = {
+        static_cast<uint32_t>(this->low),
+        static_cast<uint32_t>(this->low >> 32),
+        static_cast<uint32_t>(this->high),
+        static_cast<uint32_t>(this->high >> 32)
+    };
+    while (!value.limbs.empty() && value.limbs.back() == 0) value.limbs.pop_back();
+    return value.to_string();
+}
+
+void BigUInt::multiply_add(uint32_t factor, uint32_t addend) {
+    uint64_t carry = addend;
+    for (uint32_t& limb : this->limbs) {
+        uint64_t product = static_cast<uint64_t>(limb) * factor + carry; // at most (2^32 - 1)^2 + 2^32 - 1, fits
+        limb = static_cast<uint32_t>(product);
+        carry = product >> 32;
+    }
+
+    if (carry != 0) this->limbs.push_back(static_cast<uint32_t>(carry));
+    while (!this->limbs.empty() && this->limbs.back() == 0) this->limbs.pop_back(); // multiplied by zero
+}
+
+std::string BigUInt::to_string() const {
+    // long division by 10^9 from the most significant limb down, a 64-bit remainder always fits the intermediate values
+    const uint64_t CHUNK_DIVISOR = 1000000000;
+    const size_t CHUNK_DIGITS = 9;
+
+    std::vector<uint32_t> limbs(this->limbs.rbegin(), this->limbs.rend()); // most significant first
+    std::string digits;
+    bool is_zero = limbs.empty();
+    while (!is_zero) {
+        uint64_t remainder = 0;
+        is_zero = true;
+        for (uint32_t& limb : limbs) {
+            uint64_t dividend = (remainder << 32) | limb;
+            limb = static_cast<uint32_t>(dividend / CHUNK_DIVISOR);
+            remainder = dividend % CHUNK_DIVISOR;
+            is_zero = is_zero && limb == 0;
+        }
+
+        for (size_t digit = 0; digit < CHUNK_DIGITS && (!is_zero || remainder != 0); digit++) { // no leading zeroes on the last chunk
+            digits.push_back(static_cast<char>('0' + remainder % 10));
+            remainder /= 10;
+        }
+    }
+
+    if (digits.empty()) digits.push_back('0');
+    std::reverse(digits.begin(), digits.end());
+    return digits;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include "worker_pool.hpp"
+
+WorkerPool::~WorkerPool() {
+    this->stop();
+}
+
+void WorkerPool::start(size_t thread_count) {
+    if (!this->workers.empty()) return;
+    if (thread_count == 0) thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t worker = 1; worker < thread_count; worker++) this->workers.emplace_back([this]() { this->work(); });
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->batch_ready.notify_all();
+    for (std::thread& worker : this->workers) worker.join();
+    this->workers.clear();
+    this->stopping = false;
+}
+
+size_t WorkerPool::thread_count() const {
+    return this->workers.size() + 1;
+}
+
+void WorkerPool::work() {
+    size_t seen_batch = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->batch_ready.wait(lock, [&]() { return this->stopping || this->batch != seen_batch; });
+            if (this->stopping) return;
+            seen_batch = this->batch;
+        }
+
+        this->take_tasks();
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (++this->finished_count == this->workers.size()) this->batch_done.notify_one();
+    }
+}
+
+void WorkerPool::take_tasks() {
+    for (size_t task = this->next_task.fetch_add(1); task < this->task_count; task = this->next_task.fetch_add(1)) (*this->run_task)(task);
+}
+
+void WorkerPool::run(size_t task_count, const std::function<void(size_t)>& run_task) {
+    if (this->workers.empty() || task_count <= 1) { // nothing to share
+        for (size_t task = 0; task < task_count; task++) run_task(task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->run_task = &run_task;
+        this->task_count = task_count;
+        this->next_task = 0;
+        this->finished_count = 0;
+        this->batch++;
+    }
+    this->batch_ready.notify_all();
+
+    this->take_tasks();
+
+    // every worker has to check in, one still waking up would otherwise find the next batch's task count with this batch's task
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->batch_done.wait(lock, [&]() { return this->finished_count == this->workers.size(); });
+}
@@ -0,0 +1,257 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "worksheet.hpp"
+#include "number_parser.hpp"
+
+// values are parsed into a small block first so the simd kernels get long uninterrupted runs
+static const size_t PARSE_BLOCK_SIZE = 256;
+
+ProblemStrides ProblemStrides::of(ProblemLayout layout, size_t problem_count, size_t values_per_problem) {
+    switch (layout) {
+        case ProblemLayout::VALUE_MAJOR: return {1, problem_count};
+        default: return {values_per_problem, 1};
+    }
+}
+
+size_t op_mask_word_count(size_t problem_count) {
+    return (problem_count + 31) / 32;
+}
+
+Worksheet Worksheet::scan(const char* text, size_t text_size) {
+    Worksheet worksheet{};
+
+    const char* cursor = text;
+    const char* text_end = text + text_size;
+    while (cursor != text_end) {
+        const char* line_end = static_cast<const char*>(std::memchr(cursor, '\n', text_end - cursor));
+        if (line_end == nullptr) line_end = text_end;
+
+        std::string_view line(cursor, line_end - cursor);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) worksheet.rows.push_back(line);
+
+        cursor = line_end == text_end ? text_end : line_end + 1;
+    }
+
+    if (worksheet.rows.empty()) return worksheet;
+    worksheet.ops = worksheet.rows.back();
+    worksheet.rows.pop_back();
+
+    for (char op : worksheet.ops) {
+        switch (op) {
+            case '+': worksheet.add_problem_count++; break;
+            case '*': worksheet.mul_problem_count++; break;
+        }
+    }
+
+    return worksheet;
+}
+
+size_t Worksheet::total_problem_count() const {
+    return this->add_problem_count + this->mul_problem_count;
+}
+
+size_t Worksheet::values_per_problem() const {
+    return this->rows.size();
+}
+
+std::string_view Worksheet::values_text() const {
+    if (this->rows.empty()) return {};
+    const char* text_begin = this->rows.front().data();
+    const char* text_end = this->rows.back().data() + this->rows.back().size();
+    return std::string_view(text_begin, text_end - text_begin);
+}
+
+size_t WorksheetChunk::total_problem_count() const {
+    return this->add_problem_count + this->mul_problem_count;
+}
+
+WorksheetChunk Worksheet::whole() const {
+    return {this->add_problem_count, this->mul_problem_count};
+}
+
+std::vector<WorksheetChunk> Worksheet::split(size_t max_problems_per_chunk) const {
+    std::vector<WorksheetChunk> chunks;
+    WorksheetChunk chunk{};
+    for (char op : this->ops) {
+        switch (op) {
+            case '+': chunk.add_problem_count++; break;
+            case '*': chunk.mul_problem_count++; break;
+            default: continue;
+        }
+
+        if (chunk.total_problem_count() == max_problems_per_chunk) {
+            chunks.push_back(chunk);
+            chunk = {};
+        }
+    }
+
+    if (chunk.total_problem_count() > 0 || chunks.empty()) chunks.push_back(chunk);
+    return chunks;
+}
+
+WorksheetCursor Worksheet::begin() const {
+    WorksheetCursor cursor{};
+    for (std::string_view row : this->rows) cursor.rows.push_back(row.data());
+    cursor.op = this->ops.data();
+    return cursor;
+}
+
+void Worksheet::fill_problems(uint32_t* add_problems, uint32_t* mul_problems, ProblemLayout layout) const {
+    WorksheetCursor cursor = this->begin();
+    this->fill_problems(cursor, this->whole(), add_problems, mul_problems, layout);
+}
+
+void Worksheet::fill_problems(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* add_problems, uint32_t* mul_problems, ProblemLayout layout) const {
+    static const NumberParser parse_numbers = select_number_parser();
+    size_t values_per_problem = this->values_per_problem();
+    size_t total_problem_count = chunk.total_problem_count();
+    ProblemStrides add_strides = ProblemStrides::of(layout, chunk.add_problem_count, values_per_problem);
+    ProblemStrides mul_strides = ProblemStrides::of(layout, chunk.mul_problem_count, values_per_problem);
+
+    // walk the file one row at a time so the input is read strictly front to back, with a value major layout the writes are sequential too
+    const char* chunk_ops = cursor.op;
+    for (size_t row_index = 0; row_index < values_per_problem; row_index++) {
+        const char*& row_cursor = cursor.rows[row_index];
+        const char* row_end = this->rows[row_index].data() + this->rows[row_index].size();
+        const char* op = chunk_ops;
+        uint32_t* add_value = add_problems + row_index * add_strides.value_stride;
+        uint32_t* mul_value = mul_problems + row_index * mul_strides.value_stride;
+
+        uint32_t block[PARSE_BLOCK_SIZE];
+        size_t remaining_count = total_problem_count;
+        while (remaining_count > 0) {
+            size_t block_count = parse_numbers(row_cursor, row_end, block, std::min(remaining_count, PARSE_BLOCK_SIZE));
+            if (block_count == 0) { // short row, missing values read as zero like a failed stream extraction would
+                block_count = std::min(remaining_count, PARSE_BLOCK_SIZE);
+                std::fill(block, block + block_count, 0);
+            }
+
+            for (size_t index = 0; index < block_count; index++) {
+                while (*op != '+' && *op != '*') op++; // spacing between operators
+                switch (*(op++)) {
+                    case '+': {
+                        *add_value = block[index];
+                        add_value += add_strides.problem_stride;
+                        break;
+                    }
+
+                    case '*': {
+                        *mul_value = block[index];
+                        mul_value += mul_strides.problem_stride;
+                        break;
+                    }
+                }
+            }
+
+            remaining_count -= block_count;
+        }
+
+        cursor.op = op; // the same for every row
+    }
+}
+
+void Worksheet::fill_op_mask(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* op_mask) const {
+    size_t total_problem_count = chunk.total_problem_count();
+    std::fill(op_mask, op_mask + op_mask_word_count(total_problem_count), 0);
+
+    const char* op = cursor.op;
+    for (size_t problem = 0; problem < total_problem_count; problem++) {
+        while (*op != '+' && *op != '*') op++; // spacing between operators
+        if (*(op++) == '*') op_mask[problem / 32] |= uint32_t(1) << (problem % 32);
+    }
+
+    cursor.op = op;
+}
+
+void Worksheet::fill_problems_in_order(WorksheetCursor& cursor, const WorksheetChunk& chunk, uint32_t* problems, uint32_t* op_mask, ProblemLayout layout) const {
+    static const NumberParser parse_numbers = select_number_parser();
+    size_t values_per_problem = this->values_per_problem();
+    size_t total_problem_count = chunk.total_problem_count();
+    ProblemStrides strides = ProblemStrides::of(layout, total_problem_count, values_per_problem);
+    this->fill_op_mask(cursor, chunk, op_mask);
+
+    // nothing depends on the operators anymore, so with a value major layout each row is parsed straight into place
+    for (size_t row_index = 0; row_index < values_per_problem; row_index++) {
+        const char*& row_cursor = cursor.rows[row_index];
+        const char* row_end = this->rows[row_index].data() + this->rows[row_index].size();
+        uint32_t* value = problems + row_index * strides.value_stride;
+
+        uint32_t block[PARSE_BLOCK_SIZE];
+        size_t remaining_count = total_problem_count;
+        while (remaining_count > 0) {
+            uint32_t* destination = strides.problem_stride == 1 ? value : block;
+            size_t block_count = parse_numbers(row_cursor, row_end, destination, std::min(remaining_count, PARSE_BLOCK_SIZE));
+            if (block_count == 0) { // short row, missing values read as zero like a failed stream extraction would
+                block_count = std::min(remaining_count, PARSE_BLOCK_SIZE);
+                std::fill(destination, destination + block_count, 0);
+            }
+
+            if (strides.problem_stride == 1) {
+                value += block_count;
+            } else {
+                for (size_t index = 0; index < block_count; index++, value += strides.problem_stride) *value = block[index];
+            }
+            remaining_count -= block_count;
+        }
+    }
+}
+
+void Worksheet::fill_problem_slots(uint32_t* problem_slots) const {
+    uint32_t add_slot = 0;
+    uint32_t mul_slot = static_cast<uint32_t>(this->add_problem_count); // the mul region directly follows the add region
+    for (char op : this->ops) {
+        switch (op) {
+            case '+': *(problem_slots++) = add_slot++; break;
+            case '*': *(problem_slots++) = mul_slot++; break;
+        }
+    }
+}
+
+std::string generate_worksheet(const WorksheetShape& shape) {
+    std::mt19937_64 random(shape.seed);
+    std::uniform_int_distribution<size_t> digit_count_distribution(shape.min_digits, shape.max_digits);
+    std::bernoulli_distribution mul_distribution(shape.mul_fraction);
+
+    uint32_t powers_of_ten[10] = {1};
+    for (size_t power = 1; power < 10; power++) powers_of_ten[power] = powers_of_ten[power - 1] * 10;
+    auto values_with_digits = [&](size_t min_digits, size_t max_digits) { // no leading zeroes, and no zero either
+        return std::uniform_int_distribution<uint32_t>(powers_of_ten[min_digits - 1], powers_of_ten[max_digits] - 1);
+    };
+    std::uniform_int_distribution<uint32_t> value_distribution = values_with_digits(shape.min_digits, shape.max_digits);
+
+    size_t column_size = shape.max_digits + 1; // a separating space after every column
+    std::string text;
+    text.reserve((shape.problem_count * column_size + 1) * (shape.values_per_problem + 1));
+    for (size_t row = 0; row < shape.values_per_problem; row++) {
+        for (size_t problem = 0; problem < shape.problem_count; problem++) {
+            uint32_t value;
+            if (shape.value_distribution == ValueDistribution::UNIFORM_VALUE) {
+                value = value_distribution(random);
+            } else {
+                size_t digit_count = digit_count_distribution(random);
+                value = values_with_digits(digit_count, digit_count)(random);
+            }
+
+            char digits[10];
+            char* digits_end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+            text.append(digits, digits_end);
+            text.append(column_size - (digits_end - digits), ' ');
+        }
+        text.push_back('\n');
+    }
+
+    for (size_t problem = 0; problem < shape.problem_count; problem++) {
+        text.push_back(mul_distribution(random) ? '*' : '+');
+        text.append(column_size - 1, ' ');
+    }
+    text.push_back('\n');
+
+    return text;
+}